@@ -17,13 +17,18 @@ public:
   const value_type& data() const;
   Parser& require(const std::string& key);
   Parser& optional(const std::string& key);
+  //! registers a key that takes no value
+  Parser& flag(const std::string& key);
   bool validate() const;
   std::string get(const std::string& key) const;
+  bool has(const std::string& key) const;
 protected:
   value_type data_;
   std::size_t counter_ = 1;
   //! map<key, tuple<required, key found, value>>
   std::map<std::string, std::tuple<bool, bool, std::string>> dashed_;
+  //! map<key, key found>
+  std::map<std::string, bool> flags_;
 private:
 };
 
@@ -80,6 +85,11 @@ Parser& Parser::optional(const std::string& key) {
   return *this;
 }
 
+Parser& Parser::flag(const std::string& key) {
+  flags_.insert({key, std::get<bool>(this->find(key))});
+  return *this;
+}
+
 bool Parser::validate() const {
   for (const auto& pair : dashed_) {
     if (
@@ -96,7 +106,12 @@ bool Parser::validate() const {
         return !std::get<std::string>(pair.second).empty();
       }
   ));
-  if (data_.size() != (nonEmpty * 2 + 1 + 1)) {
+  const auto flags = static_cast<std::size_t>(std::count_if(
+      flags_.begin(),
+      flags_.end(),
+      [](const auto& pair) { return pair.second; }
+  ));
+  if (data_.size() != (nonEmpty * 2 + flags + 1 + 1)) {
     return false;
   }
   return true;
@@ -106,6 +121,10 @@ std::string Parser::get(const std::string& key) const {
   return std::get<std::string>(dashed_.at(key));
 }
 
+bool Parser::has(const std::string& key) const {
+  return flags_.at(key);
+}
+
 } /// namespace args
 
 #endif /// ARGS_ARGS_HH_
@@ -7,8 +7,13 @@
 #include <aws/s3/S3Client.h>
 #include <aws/s3/model/PutObjectRequest.h>
 #include <aws/s3/model/ListObjectsRequest.h>
+#include <aws/s3/model/ListObjectsV2Request.h>
 #include <aws/s3/model/GetObjectRequest.h>
+#include <aws/s3/model/HeadObjectRequest.h>
 #include <aws/s3/model/DeleteObjectRequest.h>
+#include <aws/s3/model/DeleteObjectsRequest.h>
+#include <aws/s3/model/CopyObjectRequest.h>
+#include <aws/s3/model/UploadPartCopyRequest.h>
 #include <aws/s3/model/WebsiteConfiguration.h>
 #include <aws/s3/model/PutBucketPolicyRequest.h>
 #include <aws/s3/model/PutBucketWebsiteRequest.h>
@@ -16,33 +21,193 @@
 #include <aws/s3/model/CreateBucketConfiguration.h>
 #include <aws/s3/model/PutPublicAccessBlockRequest.h>
 #include <aws/s3/model/PutBucketAclRequest.h>
+#include <aws/s3/model/CreateMultipartUploadRequest.h>
+#include <aws/s3/model/UploadPartRequest.h>
+#include <aws/s3/model/CompleteMultipartUploadRequest.h>
+#include <aws/s3/model/AbortMultipartUploadRequest.h>
+#include <aws/core/utils/stream/PreallocatedStreamBuf.h>
+#include <aws/core/utils/ratelimiter/RateLimiterInterface.h>
+#include <aws/core/utils/stream/ResponseStream.h>
+#include <aws/core/http/HttpClient.h>
+#include <aws/core/http/HttpClientFactory.h>
+#include <aws/core/http/HttpResponse.h>
+#include <exif/exif.hh>
+#include <gzip/gzip.hh>
+#include <io/io.hh>
+#include <jpeg/jpeg.hh>
+#include <keys/keys.hh>
+#include <mapped/mapped.hh>
+#include <md5/md5.hh>
+#include <pack/pack.hh>
+#include <pool/pool.hh>
+#include <parallel/parallel.hh>
+#include <rate/rate.hh>
+#include <tar/tar.hh>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <set>
 #include <string>
+#include <sstream>
+#include <cstring>
 
 #ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
 #include <unistd.h>
 #endif
 
 namespace cloud {
 
+//! Stream over caller-owned memory, used to hand pool slabs to the SDK as
+//! request and response bodies without copying
+class SlabStream : public Aws::IOStream {
+public:
+  SlabStream(unsigned char* data, std::size_t size);
+protected:
+  Aws::Utils::Stream::PreallocatedStreamBuf buf_;
+private:
+};
+
+//! SDK rate limiter charging a shared bucket with the priority of the
+//! calling thread
+class Limiter : public Aws::Utils::RateLimits::RateLimiterInterface {
+public:
+  explicit Limiter(std::shared_ptr<rate::Bucket> bucket);
+  DelayType ApplyCost(int64_t cost) override;
+  void ApplyAndPayForCost(int64_t cost) override;
+  void SetRate(int64_t rate, bool resetAccumulator = false) override;
+protected:
+  std::shared_ptr<rate::Bucket> bucket_;
+private:
+};
+
+//! listed object with the metadata returned by the listing itself
+struct Object {
+  std::string key;
+  std::size_t size = 0;
+  std::string etag;
+};
+
+//! headers stored with an object and sent along with it, empty ones are
+//! left out
+struct Headers {
+  std::string contentType;
+  std::string contentEncoding;
+  std::string cacheControl;
+  std::map<std::string, std::string> metadata; /// x-amz-meta-* by name
+};
+
+//! condition of a PUT replacing an object only as its writer read it: the
+//! object still has 'etag', or does not exist for an empty one
+struct Precondition {
+  std::string etag;
+  bool conflict = false; /// set when the PUT was refused for the condition
+};
+
+//! object of the generated web site
+struct SiteFile {
+  std::string key;
+  std::string body;
+  Headers headers;
+};
+
+//! result of comparing a local directory with an album
+struct Report {
+  std::vector<std::string> missing; /// local photos absent from the album
+  std::vector<std::string> extra; /// album photos absent locally
+  std::vector<std::string> mismatched; /// photos whose content differs
+  std::vector<std::string> unverifiable; /// photos with a malformed ETag
+};
+
+//! transfer parameters of one endpoint, by default those of the SDK and as
+//! many transfers as the memory limit allows
+struct Profile {
+  std::size_t partSize = 8 * 1024 * 1024;
+  std::size_t concurrency = 0; /// 0 is as many as the memory allows
+  std::size_t maxConnections = 25;
+  std::size_t requestTimeoutMs = 3000;
+  std::size_t connectTimeoutMs = 1000;
+  std::size_t tcpKeepAliveMs = 30000; /// 0 disables keep-alive
+};
+
 class Cloud {
 public:
+  //! most key prefixes an album can be spread over
+  static constexpr std::size_t MAX_SHARDS = 256;
+  //! told the key and size of every body sent or received, from the
+  //! transfer threads
+  using Progress = std::function<void(
+      const std::string& key,
+      std::size_t bytes
+  )>;
+
   Cloud();
+  //! instance configured by 'configFile' instead of the user's cloudphotorc
+  explicit Cloud(const std::filesystem::path& configFile);
+  virtual ~Cloud() = default;
   bool init();
+  void setMaxMemory(std::size_t bytes);
+  //! bytes per second sent and received by all transfers together, 0 is
+  //! unlimited; may be changed while transfers are running
+  void setLimitRate(std::size_t up, std::size_t down);
+  //! applies the rate limits of the configuration file again
+  bool reloadLimitRate() const;
+  //! must not be changed while transfers are running
+  void setProgress(Progress progress);
+  //! photos uploaded one object per photo are re-encoded losslessly first
+  //! (when that makes them smaller), dropping 'strip' metadata
+  void setOptimize(std::optional<jpeg::Strip> strip);
+  //! used instead of the profile of the configuration file, takes effect
+  //! at 'init'
+  void setProfile(const Profile& profile);
+  //! albums created by an upload from now on spread their photos over
+  //! 'count' (at most 256) key prefixes, 0 keeps them under the album's
+  //! own; replaces the default of the configuration file
+  void setShards(std::size_t count);
   bool deinit();
   bool upload(
     const std::string& album,
-    const std::filesystem::path& dir
+    const std::filesystem::path& dir,
+    bool packed = false
+  ) const;
+  //! uploads 'dir', then every photo written or moved into it, until
+  //! SIGINT or SIGTERM; SIGHUP reloads the rate limits (threads the SDK
+  //! starts in 'init' never take these signals)
+  bool watch(
+    const std::string& album,
+    const std::filesystem::path& dir,
+    bool packed = false
   ) const;
+  //! uploads the photos of the tar archive read from 'fd' in one pass,
+  //! straight from the stream
+  bool uploadTar(const std::string& album, int fd) const;
   bool download(
     const std::string& album,
-    const std::filesystem::path& dir
+    const std::filesystem::path& dir,
+    io::Durability durability = io::Durability::NONE
   ) const;
-  std::optional<std::set<std::string>> albums() const;
-  std::optional<std::set<std::string>> get(const std::string& album) const;
+  std::optional<keys::Keys> albums() const;
+  std::optional<keys::Keys> get(const std::string& album) const;
+  //! capture date, dimensions and camera of the photos of 'album' as
+  //! recorded at upload, without touching the photos
+  std::optional<exif::Index> meta(const std::string& album) const;
+  //! records the metadata of photos uploaded before it was recorded, reading
+  //! only their header bytes
+  bool backfill(const std::string& album) const;
   bool del(
     const std::string& album,
     const std::string& photo
@@ -50,7 +215,33 @@ public:
   bool del(
       const std::string& album
   ) const;
-  std::string mksite() const;
+  //! refuses an album with a key under '.pack/' that is not a pack number
+  bool copy(const std::string& album, const std::string& to) const;
+  bool move(const std::string& album, const std::string& to) const;
+  //! turns a packed album into one object per photo, server-side
+  bool unpack(const std::string& album) const;
+  //! streams objects under 'album' (the whole bucket if empty) into the
+  //! same keys of 'destination', skipping objects with an equal ETag
+  bool mirror(const std::string& album, const Cloud& destination) const;
+  //! compares local photos with the album using listed ETags; a photo whose
+  //! ETag differs is looked up once more for the MD5 it had before
+  //! '--optimize'
+  std::optional<Report> verify(
+      const std::string& album,
+      const std::filesystem::path& dir
+  ) const;
+  //! publishes the albums as a static site; 'vendor' serves the scripts
+  //! and styles of the pages from the bucket instead of their CDNs. Pages
+  //! link every photo by its own key, so packed albums are refused and
+  //! told to 'packed'
+  std::string mksite(
+      bool vendor = false,
+      std::vector<std::string>* packed = nullptr
+  ) const;
+  //! times short transfers under a scratch prefix with a sweep of
+  //! profiles and saves the fastest one to the configuration file, where
+  //! every later 'init' finds it
+  std::optional<Profile> calibrate() const;
   bool configure(
       const std::string& keyId,
       const std::string& key,
@@ -58,14 +249,342 @@ public:
       const std::string& region = "ru-central1",
       const std::string& endpoint = "https://storage.yandexcloud.net"
   );
+  //! whether 'key' is stored under 'album', in one of its shards or not
+  static bool isAlbumKey(std::string_view album, std::string_view key);
 protected:
+  //! keys of 'prefixes[prefix]' after 'after' up to and including 'last',
+  //! empty for no bound
+  struct Range {
+    std::size_t prefix = 0;
+    std::string after;
+    std::string last;
+  };
+
+  //! listed objects of an album, those of its shards included
+  struct Album {
+    std::vector<Object> objects;
+    std::size_t shards = 0;
+  };
+
+  //! fills 'length' bytes of the body starting at 'offset' into 'buffer'
+  using Filler = std::function<bool(
+      unsigned char* buffer,
+      std::size_t offset,
+      std::size_t length
+  )>;
+  //! blocks the worker of the part at 'offset' until it may fill it, called
+  //! before the worker takes its slab so that waiting workers hold none
+  using Turn = std::function<void(std::size_t offset)>;
+
+  //! with 'uploaded' given, a file that fails does not stop the others and
+  //! 'uploaded' is told which ones made it
+  bool upload(
+      const std::string& album,
+      const std::vector<std::filesystem::path>& files,
+      bool packed,
+      std::vector<char>* uploaded = nullptr
+  ) const;
+  //! everything 'init' does but the signal mask
+  bool start();
+  //! SIGINT, SIGTERM and SIGHUP, which 'watch' receives through a signalfd
+  static sigset_t watched();
   bool put(const std::string& data, std::string key) const;
   bool put(const std::filesystem::path& path, std::string key) const;
+  bool put(
+      const std::string& key,
+      std::size_t size,
+      const Filler& fill,
+      const Headers& headers = Headers(),
+      Precondition* precondition = nullptr,
+      const Turn& turn = Turn()
+  ) const;
+  //! single PUT of 'size' bytes already in 'data'
+  bool put(
+      const std::string& key,
+      const unsigned char* data,
+      std::size_t size,
+      const Headers& headers = Headers(),
+      Precondition* precondition = nullptr
+  ) const;
+  //! replaces 'key' by what 'change' makes of its content (nothing for a
+  //! missing object) with a conditional PUT, reading and changing it again
+  //! while other writers come in between; 'change' returns false to fail
+  bool update(
+      const std::string& key,
+      const std::function<bool(std::optional<std::string>& content)>& change
+  ) const;
+  static bool isConflict(const Aws::S3::S3Error& error);
+  bool fetch(
+      const std::string& key,
+      const std::filesystem::path& path,
+      io::Durability durability
+  ) const;
+  //! reads at most one slab of 'key' starting at 'offset' into 'buffer',
+  //! returns the number of bytes read (0 from an empty object); 'headers'
+  //! is told the headers stored with the object. A 'length' of 0 reads
+  //! nothing and sends no request, 'total' and 'headers' are left as they are
+  std::optional<std::size_t> getRange(
+      const std::string& key,
+      std::size_t offset,
+      std::size_t length,
+      unsigned char* buffer,
+      std::size_t* total = nullptr,
+      Headers* headers = nullptr
+  ) const;
+  //! headers stored with 'key'
+  std::optional<Headers> head(const std::string& key) const;
+  template <typename Request>
+  static void setHeaders(Request& request, const Headers& headers);
+  template <typename Result>
+  static Headers getHeaders(const Result& result);
+  std::optional<std::string> load(const std::string& key) const;
+  //! objects under 'prefix' in key order
+  std::optional<std::vector<Object>> objects(const std::string& prefix) const;
+  //! objects under each of 'prefixes' in key order, listed together: a
+  //! worker that is done takes over a part of a range still being listed,
+  //! so large prefixes are listed in parallel too
+  std::optional<std::vector<std::vector<Object>>> objects(
+      const std::vector<std::string>& prefixes
+  ) const;
+  //! lists the objects under each of 'prefixes' as 'objects' does, handing
+  //! every page to 'visit' along with the range it belongs to as soon as it
+  //! arrives; the pages of one range come in key order, 'visit' may be
+  //! called from several workers at once and returns false to stop
+  bool list(
+      const std::vector<std::string>& prefixes,
+      const std::function<bool(const Range& range, std::vector<Object>& page)>&
+          visit
+  ) const;
+  //! one page of a listing, every listing goes through here; a check
+  //! answers it from memory
+  virtual Aws::S3::Model::ListObjectsV2Outcome listObjects(
+      const Aws::S3::Model::ListObjectsV2Request& request
+  ) const;
+  //! objects of 'album' and, for a sharded album, those of every shard;
+  //! 'shards' is told the album's shard count
+  std::optional<std::vector<Object>> albumObjects(
+      const std::string& album,
+      std::size_t* shards = nullptr
+  ) const;
+  std::optional<std::vector<Album>> albumObjects(
+      const std::vector<std::string>& albums
+  ) const;
+  //! at most 'count' increasing bounds between 'after' and 'last' (empty
+  //! for the end of the prefix) that cut the rest of a range into ranges,
+  //! 'first' and 'after' being the first and the last key of its last page
+  static std::vector<std::string> split(
+      const std::string& first,
+      const std::string& after,
+      const std::string& last,
+      std::size_t count
+  );
+  bool copyObject(const Object& source, const std::string& key) const;
+  bool copyRange(
+      const std::string& source,
+      std::size_t offset,
+      std::size_t length,
+      const std::string& key,
+      const Headers& headers = Headers()
+  ) const;
+  bool uploadPacked(
+      const std::string& album,
+      const std::vector<std::filesystem::path>& files,
+      std::vector<char>* uploaded = nullptr
+  ) const;
+  bool fetchPacked(
+      const std::string& album,
+      const pack::Index& index,
+      const keys::Keys& skip,
+      const std::filesystem::path& dir,
+      io::Durability durability
+  ) const;
+  //! index of a packed album, an empty index if the album is not packed
+  std::optional<pack::Index> index(
+      const std::string& album,
+      const std::vector<Object>& objects
+  ) const;
+  //! metadata index of 'album' listed as 'objects', empty if it has none
+  std::optional<exif::Index> meta(
+      const std::string& album,
+      const std::vector<Object>& objects
+  ) const;
+  //! shard count of 'album' by its manifest, 0 if it is not sharded
+  std::optional<std::size_t> shards(const std::string& album) const;
+  std::optional<std::size_t> shards(
+      const std::string& album,
+      const std::vector<Object>& objects
+  ) const;
+  //! shard count of 'album' for an upload, an album without objects yet
+  //! is given 'create' shards
+  std::optional<std::size_t> layout(
+      const std::string& album,
+      std::size_t create
+  ) const;
+  static bool isReserved(std::string_view name);
+  static bool isShardKey(std::string_view key);
+  //! an album named like a shard prefix ('.' and two hex digits) would be
+  //! taken for one and never listed
+  static bool isAlbumName(std::string_view album);
+  static bool isPhoto(const std::filesystem::path& path);
+  static std::vector<std::filesystem::path> photos(
+      const std::filesystem::path& dir
+  );
+  static std::string packKey(const std::string& album, std::uint32_t pack);
+  static std::string indexKey(const std::string& album);
+  static std::string metaKey(const std::string& album);
+  static std::string shardsKey(const std::string& album);
+  static std::string shardPrefix(std::size_t shard);
+  //! key of photo 'name' of an album with 'shards' shards
+  static std::string photoKey(
+      const std::string& album,
+      const std::string& name,
+      std::size_t shards
+  );
+  //! name of the photo of 'album' stored under 'key'
+  static std::string photoName(
+      const std::string& album,
+      const std::string& key
+  );
+  //! adds 'entries' to the metadata index of 'album'
+  bool record(const std::string& album, exif::Index::value_type entries) const;
+  //! applies 'change' to the metadata index of 'album' through 'update', so
+  //! no entry another writer added meanwhile is lost
+  bool updateMeta(
+      const std::string& album,
+      const std::function<void(exif::Index& meta)>& change
+  ) const;
+  bool del(const std::vector<std::string>& keys) const;
+  //! plain GET of a URL outside the bucket
+  std::optional<std::string> fetchUrl(const std::string& url) const;
+  //! points every CDN URL of 'page' to a copy of the asset in the bucket,
+  //! adding the copies to 'assets'
+  bool vendor(std::string& page, std::vector<SiteFile>& assets) const;
+  //! key of the content-hashed copy of the asset at 'url' (and of what a
+  //! style sheet refers to), empty on failure
+  std::string vendorAsset(
+      const std::string& url,
+      std::vector<SiteFile>& assets
+  ) const;
+  //! compresses text files and uploads 'files' on all workers, skipping
+  //! the keys in 'skip'
+  bool publish(
+      const std::vector<SiteFile>& files,
+      const keys::Keys& skip
+  ) const;
+  //! throughput and slowest request of a probe run
+  struct Probe {
+    double rate = 0; /// bytes per second
+    std::chrono::milliseconds slowest{0};
+    std::chrono::milliseconds connect{0}; /// to the first response
+  };
+
+  //! uploads and reads back the probe objects under 'prefix' with a new
+  //! instance using 'profile'
+  std::optional<Probe> probe(
+      const Profile& profile,
+      const std::string& prefix
+  ) const;
+  //! the defaults overridden by the profile keys of 'config'
+  static std::optional<Profile> readProfile(const std::string& config);
+  //! replaces the profile keys of the configuration file
+  bool saveProfile(const Profile& profile) const;
+  static std::string contentType(std::string_view key);
+  static std::string pageKey(std::size_t album, std::size_t page);
+  static std::string readIniLine(
+      const std::string& config,
+      const std::string& key
+  );
   std::string read(const std::filesystem::path& path) const;
+  std::size_t jobs() const;
+  void report(const std::string& key, std::size_t bytes) const;
+  //! re-encodes the photo of 'size' bytes at 'data' in place if that makes
+  //! it smaller, returns its size
+  std::size_t optimize(unsigned char* data, std::size_t size) const;
 
   std::optional<Aws::S3::S3Client> client_;
   Aws::SDKOptions options_;
   std::string bucket_;
+  std::optional<std::size_t> maxMemory_;
+  std::unique_ptr<pool::Pool> pool_;
+  bool initialised_ = false;
+  std::optional<std::size_t> limitUp_;
+  std::optional<std::size_t> limitDown_;
+  std::shared_ptr<rate::Bucket> up_ = std::make_shared<rate::Bucket>();
+  std::shared_ptr<rate::Bucket> down_ = std::make_shared<rate::Bucket>();
+  Progress progress_;
+  std::optional<jpeg::Strip> optimize_;
+  std::optional<Profile> profile_;
+  std::optional<std::size_t> shards_;
+  /// re-encoding holds a whole photo's coefficients, once per core
+  mutable parallel::Semaphore optimizing_{
+    std::thread::hardware_concurrency()
+  };
+
+  /// the SDK is initialised once for all instances
+  static inline std::mutex sdkMutex_;
+  static inline std::size_t sdkUsers_ = 0;
+
+  static constexpr std::size_t PART_SIZE = 8 * 1024 * 1024;
+  /// S3 rejects smaller parts but the last one
+  static constexpr std::size_t MIN_PART_SIZE = 5 * 1024 * 1024;
+  static constexpr std::size_t DEFAULT_MAX_MEMORY = 128 * 1024 * 1024;
+  /// largest object a single CopyObject can handle
+  static constexpr std::size_t MAX_COPY_SIZE = 5ull * 1024 * 1024 * 1024;
+  static constexpr std::size_t COPY_PART_SIZE = 512 * 1024 * 1024;
+  static constexpr std::size_t DELETE_BATCH_SIZE = 1000;
+  static constexpr std::size_t PACK_SIZE = 256 * 1024 * 1024;
+  /// ranges of one pack closer than this are fetched with a single GET
+  static constexpr std::size_t COALESCE_GAP = 256 * 1024;
+  static constexpr std::string_view PACK_PREFIX = ".pack/";
+  static constexpr std::string_view INDEX_NAME = ".index";
+  static constexpr std::string_view META_NAME = ".meta";
+  /// a sharded album keeps its shard count here, its photos are under
+  /// '.<shard in hex>/<album>/'
+  static constexpr std::string_view SHARDS_NAME = ".shards";
+  static constexpr std::size_t MEBIBYTE = 1024 * 1024;
+  /// bodies of this size and more yield bandwidth to smaller transfers
+  static constexpr std::size_t BULK_SIZE = 1024 * 1024;
+  /// small files read by one worker with a single batch of system calls
+  static constexpr std::size_t READ_BATCH = 32;
+  /// a watched photo is uploaded once no other photo arrived for
+  /// 'WATCH_DEBOUNCE', but never later than 'WATCH_MAX_DELAY' after it
+  /// arrived or once 'WATCH_BATCH' photos are waiting
+  static constexpr std::chrono::milliseconds WATCH_DEBOUNCE{500};
+  static constexpr std::chrono::milliseconds WATCH_MAX_DELAY{3000};
+  static constexpr std::size_t WATCH_BATCH = 256;
+  /// failed photos are retried no sooner than this, and given up after
+  /// 'WATCH_ATTEMPTS' attempts
+  static constexpr std::chrono::milliseconds WATCH_RETRY{5000};
+  static constexpr std::size_t WATCH_ATTEMPTS = 5;
+  /// conditional updates of the index objects lost to other writers in a
+  /// row before giving up
+  static constexpr std::size_t UPDATE_ATTEMPTS = 16;
+  /// metadata of a mirrored object naming the ETag of its source, which a
+  /// copy made by another PUT layout does not share
+  static constexpr std::string_view SOURCE_ETAG_META = "source-etag";
+  /// metadata of an optimized photo naming the MD5 of the local file it was
+  /// made from, which its own ETag no longer is
+  static constexpr std::string_view SOURCE_MD5_META = "source-md5";
+  /// vendored site assets, named by their content
+  static constexpr std::string_view SITE_PREFIX = ".site/";
+  static constexpr std::size_t SITE_HASH_LENGTH = 16;
+  /// album pages hold at most this many photos, larger albums are split
+  static constexpr std::size_t SITE_PAGE_SIZE = 500;
+  /// pages are revalidated on every view, assets never change
+  static constexpr std::string_view PAGE_CACHE_CONTROL = "no-cache";
+  static constexpr std::string_view ASSET_CACHE_CONTROL =
+      "public, max-age=31536000, immutable";
+  /// calibration uploads and reads back photo sized objects and one object
+  /// taking several parts, incompressible so no proxy flatters a candidate
+  static constexpr std::string_view PROBE_PREFIX = ".calibrate/";
+  static constexpr std::size_t PROBE_PHOTOS = 16;
+  static constexpr std::size_t PROBE_PHOTO_SIZE = 2 * 1024 * 1024;
+  static constexpr std::size_t PROBE_LARGE_SIZE = 32 * 1024 * 1024;
+  /// a candidate replaces the best one so far only if this much faster,
+  /// so noise does not pick a costlier profile
+  static constexpr double PROBE_MARGIN = 0.05;
+  /// timeouts are this many times the slowest probe request
+  static constexpr std::size_t TIMEOUT_FACTOR = 4;
 
   std::filesystem::path configFile_ =
       ".config/cloudphoto/cloudphotorc";
@@ -74,6 +593,20 @@ protected:
   static constexpr std::string_view SECRET_KEY_KEY = "aws_secret_access_key";
   static constexpr std::string_view REGION_KEY = "region";
   static constexpr std::string_view ENDPOINT_KEY = "endpoint_url";
+  static constexpr std::string_view MAX_MEMORY_KEY = "max_memory";
+  static constexpr std::string_view LIMIT_UP_KEY = "limit_rate_up";
+  static constexpr std::string_view LIMIT_DOWN_KEY = "limit_rate_down";
+  static constexpr std::string_view SHARDS_KEY = "shards";
+  /// transfer profile, written by 'calibrate'
+  static constexpr std::pair<std::string_view, std::size_t Profile::*>
+      PROFILE_KEYS[] = {
+    {"part_size", &Profile::partSize},
+    {"concurrency", &Profile::concurrency},
+    {"max_connections", &Profile::maxConnections},
+    {"request_timeout_ms", &Profile::requestTimeoutMs},
+    {"connect_timeout_ms", &Profile::connectTimeoutMs},
+    {"tcp_keep_alive_ms", &Profile::tcpKeepAliveMs},
+  };
 private:
 };
 
@@ -89,12 +622,59 @@ std::string& replace(
 
 std::string urlEncode(const std::string& value);
 
+std::string htmlEscape(const std::string& value);
+
+//! drops the indentation and the empty lines of a page, the templates have
+//! no whitespace sensitive elements
+std::string minifyHtml(const std::string& value);
+
+//! parses sizes like "4096", "64K", "512M" or "4G"
+std::optional<std::size_t> parseSize(const std::string& value);
+
+bool readAll(
+    int fd,
+    unsigned char* buffer,
+    std::size_t size,
+    std::size_t offset
+);
+bool writeAll(
+    int fd,
+    const unsigned char* buffer,
+    std::size_t size,
+    std::size_t offset
+);
+
+md5::Digest digest(const mapped::File& file);
+
+//! ETag S3 gives an object uploaded in parts of 'partSize' bytes
+std::string multipartEtag(const mapped::File& file, std::size_t partSize);
+
 } /// namespace util
 
 /// implementation
 
 namespace cloud {
 
+SlabStream::SlabStream(unsigned char* data, std::size_t size)
+    : Aws::IOStream(&buf_), buf_(data, size) {}
+
+Limiter::Limiter(std::shared_ptr<rate::Bucket> bucket)
+    : bucket_(std::move(bucket)) {}
+
+Limiter::DelayType Limiter::ApplyCost(int64_t cost) {
+  return bucket_->delay(static_cast<std::size_t>(std::max<int64_t>(cost, 0)));
+}
+
+void Limiter::ApplyAndPayForCost(int64_t cost) {
+  bucket_->acquire(
+      static_cast<std::size_t>(std::max<int64_t>(cost, 0)), rate::current()
+  );
+}
+
+void Limiter::SetRate(int64_t rate, bool) {
+  bucket_->setRate(static_cast<std::size_t>(std::max<int64_t>(rate, 0)));
+}
+
 #ifdef __linux__
 Cloud::Cloud() {
   // char const* home = std::getenv("HOME");
@@ -133,24 +713,31 @@ Cloud::Cloud() {
 #error your OS is not supported
 #endif
 
+Cloud::Cloud(const std::filesystem::path& configFile)
+    : configFile_(configFile) {}
+
 bool Cloud::init() {
-  const auto readIniLine = [](
-      const std::string& config,
-      const std::string& key
-  ) {
-    const std::string pattern = key + " = ";
-    const auto begin = config.find(key);
-    if (begin == std::string::npos) {
-      return std::string();
-    }
-    const std::string substr = config.substr(begin + pattern.size());
-    const auto end = substr.find("\n");
-    return substr.substr(0, end);
-  };
+  /// the SDK starts threads of its own here, they inherit the blocked mask
+  /// so no signal meant for 'watch' is ever delivered to one of them; the
+  /// calling thread gets its mask back, other commands stay interruptible
+  const auto signals = watched();
+  sigset_t previous;
+  pthread_sigmask(SIG_BLOCK, &signals, &previous);
+  const auto ok = start();
+  pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+  return ok;
+}
 
+bool Cloud::start() {
   const std::string conf = read(configFile_);
   options_.loggingOptions.logLevel = Aws::Utils::Logging::LogLevel::Debug;
-  Aws::InitAPI(options_);
+  {
+    std::lock_guard<std::mutex> lock(sdkMutex_);
+    if (!initialised_ && sdkUsers_++ == 0) {
+      Aws::InitAPI(options_);
+    }
+    initialised_ = true;
+  }
   Aws::Client::ClientConfiguration config;
   {
     config.region = Aws::String(readIniLine(conf, std::string(REGION_KEY)));
@@ -164,6 +751,34 @@ bool Cloud::init() {
       return false;
     }
   }
+  if (!limitUp_.has_value() || !limitDown_.has_value()) {
+    const auto up = readIniLine(conf, std::string(LIMIT_UP_KEY));
+    const auto down = readIniLine(conf, std::string(LIMIT_DOWN_KEY));
+    up_->setRate(limitUp_.value_or(
+        up.empty() ? 0 : util::parseSize(up).value_or(0)
+    ));
+    down_->setRate(limitDown_.value_or(
+        down.empty() ? 0 : util::parseSize(down).value_or(0)
+    ));
+  }
+  if (!profile_.has_value()) {
+    profile_ = readProfile(conf);
+    if (!profile_.has_value()) {
+      return false;
+    }
+  }
+  const auto& profile = profile_.value();
+  config.maxConnections = static_cast<unsigned>(profile.maxConnections);
+  config.requestTimeoutMs = static_cast<long>(profile.requestTimeoutMs);
+  config.connectTimeoutMs = static_cast<long>(profile.connectTimeoutMs);
+  config.enableTcpKeepAlive = profile.tcpKeepAliveMs > 0;
+  if (config.enableTcpKeepAlive) {
+    config.tcpKeepAliveIntervalMs =
+        static_cast<unsigned long>(profile.tcpKeepAliveMs);
+  }
+  /// every transfer of this instance shares the two buckets
+  config.writeRateLimiter = std::make_shared<Limiter>(up_);
+  config.readRateLimiter = std::make_shared<Limiter>(down_);
   Aws::Auth::AWSCredentials credentials;
   {
     const auto keyId = readIniLine(conf, std::string(KEY_ID_KEY));
@@ -182,6 +797,28 @@ bool Cloud::init() {
   if (bucket_.empty()) {
     return false;
   }
+  if (!maxMemory_.has_value()) {
+    const auto maxMemory = readIniLine(conf, std::string(MAX_MEMORY_KEY));
+    maxMemory_ = maxMemory.empty()
+        ? DEFAULT_MAX_MEMORY
+        : util::parseSize(maxMemory).value_or(0);
+  }
+  if (!shards_.has_value()) {
+    const auto shards = readIniLine(conf, std::string(SHARDS_KEY));
+    shards_ = shards.empty() ? 0 : util::parseSize(shards).value_or(0);
+  }
+  if (shards_.value() > MAX_SHARDS) {
+    return false;
+  }
+  if (maxMemory_.value() < profile.partSize) {
+    return false;
+  }
+  /// one slab per transfer
+  auto slabs = maxMemory_.value() / profile.partSize;
+  if (profile.concurrency > 0) {
+    slabs = std::min(slabs, profile.concurrency);
+  }
+  pool_ = std::make_unique<pool::Pool>(slabs, profile.partSize);
 
   {
     {
@@ -217,426 +854,3219 @@ bool Cloud::init() {
   return true;
 }
 
-bool Cloud::deinit() {
-  Aws::ShutdownAPI(options_);
-  return true;
+void Cloud::setMaxMemory(std::size_t bytes) {
+  maxMemory_ = bytes;
 }
 
-bool Cloud::upload(
-    const std::string& album,
-    const std::filesystem::path& dir
-) const {
-  for (const auto& file : std::filesystem::directory_iterator(dir)) {
-    if (
-      file.path().extension().string() != ".jpg"
-          && file.path().extension().string() != ".jpeg"
-    ) {
-      continue;
-    }
-    if (!this->put(
-        file.path(), album + "/" + file.path().stem().string()
-    )) {
-      return false;
-    }
-  }
-  return true;
+void Cloud::setLimitRate(std::size_t up, std::size_t down) {
+  limitUp_ = up;
+  limitDown_ = down;
+  up_->setRate(up);
+  down_->setRate(down);
 }
 
-bool Cloud::download(
-    const std::string& album,
-    const std::filesystem::path& dir
-) const {
-  const auto toBeDownloaded = this->get(album);
-
-  if (!toBeDownloaded.has_value()) {
+bool Cloud::reloadLimitRate() const {
+  const std::string conf = read(configFile_);
+  if (conf.empty()) {
     return false;
   }
+  const auto up = readIniLine(conf, std::string(LIMIT_UP_KEY));
+  const auto down = readIniLine(conf, std::string(LIMIT_DOWN_KEY));
+  const auto upRate =
+      up.empty() ? std::optional<std::size_t>(0) : util::parseSize(up);
+  const auto downRate =
+      down.empty() ? std::optional<std::size_t>(0) : util::parseSize(down);
+  if (!upRate.has_value() || !downRate.has_value()) {
+    return false;
+  }
+  up_->setRate(upRate.value());
+  down_->setRate(downRate.value());
+  return true;
+}
 
-  for (const auto& key : toBeDownloaded.value()) {
-    if (key.empty()) {
-      continue;
-    }
-
-    Aws::S3::Model::GetObjectRequest object_request;
-    object_request.SetBucket(bucket_);
-    object_request.SetKey(album + "/" + key);
+void Cloud::setProgress(Progress progress) {
+  progress_ = std::move(progress);
+}
 
-    Aws::S3::Model::GetObjectOutcome get_object_outcome =
-        client_.value().GetObject(object_request);
+void Cloud::setOptimize(std::optional<jpeg::Strip> strip) {
+  optimize_ = strip;
+}
 
-    if (!get_object_outcome.IsSuccess()) {
-      return false;
-    }
+void Cloud::setProfile(const Profile& profile) {
+  profile_ = profile;
+}
 
-    auto& retrieved_file = get_object_outcome.GetResultWithOwnership().
-        GetBody();
+void Cloud::setShards(std::size_t count) {
+  shards_ = count;
+}
 
-    std::ofstream out(dir / (key + ".jpg"));
-    std::string data(std::istreambuf_iterator<char>(retrieved_file), {});
-    out << data;
+bool Cloud::deinit() {
+  client_.reset();
+  std::lock_guard<std::mutex> lock(sdkMutex_);
+  if (initialised_ && --sdkUsers_ == 0) {
+    Aws::ShutdownAPI(options_);
   }
+  initialised_ = false;
   return true;
 }
 
-std::optional<std::set<std::string>> Cloud::get(
-  const std::string& album
+bool Cloud::upload(
+    const std::string& album,
+    const std::filesystem::path& dir,
+    bool packed
 ) const {
-  Aws::S3::Model::ListObjectsRequest request;
-  request.WithBucket(bucket_);
-
-  auto outcome = client_.value().ListObjects(request);
+  return upload(album, photos(dir), packed);
+}
 
-  if (!outcome.IsSuccess()) {
-    return {};
+#ifdef __linux__
+bool Cloud::watch(
+    const std::string& album,
+    const std::filesystem::path& dir,
+    bool packed
+) const {
+  if (!isAlbumName(album)) {
+    return false;
   }
-
-  Aws::Vector<Aws::S3::Model::Object> objects =
-      outcome.GetResult().GetContents();
-
-  std::set<std::string> objectsFromAlbum;
-  for (Aws::S3::Model::Object& object : objects) {
-    const auto& key = object.GetKey();
-    if (key.substr(0, album.size() + 1) == album + "/") {
-      objectsFromAlbum.insert(key.substr(album.size() + 1));
-    }
+  const int events = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (events < 0) {
+    return false;
   }
-  return objectsFromAlbum;
-}
-
-std::optional<std::set<std::string>> Cloud::albums() const {
-  std::set<std::string> ret;
+  /// photos are complete once closed after writing or moved in, watching
+  /// starts before the initial upload so nothing written meanwhile is lost
+  if (::inotify_add_watch(
+      events, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO
+  ) < 0) {
+    ::close(events);
+    return false;
+  }
+  /// the signals are received through a descriptor polled together with the
+  /// events, transfer threads inherit the blocked mask
+  const auto signals = watched();
+  sigset_t previous;
+  pthread_sigmask(SIG_BLOCK, &signals, &previous);
+  const int stop = ::signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
 
-  Aws::S3::Model::ListObjectsRequest request;
-  request.WithBucket(bucket_);
+  auto ok = stop >= 0 && upload(album, dir, packed);
+  using Clock = std::chrono::steady_clock;
+  /// photos waiting for their turn with the attempts made so far
+  std::map<std::filesystem::path, std::size_t> pending;
+  Clock::time_point first;
+  Clock::time_point last;
+  Clock::time_point notBefore;
+  const auto due = [&]() {
+    return std::max(
+        notBefore, std::min(last + WATCH_DEBOUNCE, first + WATCH_MAX_DELAY)
+    );
+  };
+  for (auto running = ok; running;) {
+    /// nothing is pending, so the loop sleeps until an event or a signal
+    auto timeout = -1;
+    if (!pending.empty()) {
+      timeout = static_cast<int>(std::max<std::int64_t>(
+          0,
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              due() - Clock::now()
+          ).count()
+      ));
+    }
+    pollfd fds[] = {{events, POLLIN, 0}, {stop, POLLIN, 0}};
+    if (::poll(fds, 2, timeout) < 0 && errno != EINTR) {
+      ok = false;
+      break;
+    }
+    signalfd_siginfo received;
+    while (::read(stop, &received, sizeof(received)) == sizeof(received)) {
+      if (received.ssi_signo == SIGHUP) {
+        /// a bad configuration keeps the limits in force
+        reloadLimitRate();
+      } else {
+        running = false;
+      }
+    }
 
-  auto outcome = client_.value().ListObjects(request);
+    const auto now = Clock::now();
+    const auto add = [&](const std::filesystem::path& path) {
+      /// 'upload' refuses the whole batch for a photo of a reserved name
+      if (isReserved(path.stem().string())) {
+        ok = false;
+        return;
+      }
+      if (pending.empty()) {
+        first = now;
+      }
+      last = now;
+      pending.emplace(path, 0);
+    };
+    alignas(inotify_event) char buffer[4096];
+    for (
+        auto got = ::read(events, buffer, sizeof(buffer));
+        got > 0;
+        got = ::read(events, buffer, sizeof(buffer))
+    ) {
+      for (auto* at = buffer; at < buffer + got;) {
+        const auto* event = reinterpret_cast<const inotify_event*>(at);
+        at += sizeof(inotify_event) + event->len;
+        if (event->mask & IN_Q_OVERFLOW) {
+          /// events were dropped, the directory tells what they were
+          for (const auto& path : photos(dir)) {
+            add(path);
+          }
+        } else if (event->mask & IN_IGNORED) {
+          /// the directory itself is gone
+          running = false;
+          ok = false;
+        } else if (event->len > 0 && isPhoto(event->name)) {
+          add(dir / event->name);
+        }
+      }
+    }
 
-  if (!outcome.IsSuccess()) {
-    return {};
+    if (pending.empty() || (
+        running && pending.size() < WATCH_BATCH && Clock::now() < due()
+    )) {
+      continue;
+    }
+    std::vector<std::filesystem::path> files;
+    for (auto it = pending.begin(); it != pending.end();) {
+      /// a photo removed before its turn is not an error
+      if (std::filesystem::exists(it->first)) {
+        files.push_back(it->first);
+        it++;
+      } else {
+        it = pending.erase(it);
+      }
+    }
+    /// photos that made it leave the batch, a photo that keeps failing is
+    /// given up alone and holds back the others only until then
+    std::vector<char> uploaded(files.size(), 0);
+    upload(album, files, packed, &uploaded);
+    auto failed = false;
+    for (auto i = 0u; i < files.size(); i++) {
+      const auto found = pending.find(files[i]);
+      if (uploaded[i] || ++found->second >= WATCH_ATTEMPTS) {
+        ok = ok && uploaded[i];
+        pending.erase(found);
+      } else {
+        failed = true;
+      }
+    }
+    notBefore = failed ? Clock::now() + WATCH_RETRY : Clock::time_point();
   }
+  /// photos given up or still failing when stopped
+  ok = ok && pending.empty();
 
-  Aws::Vector<Aws::S3::Model::Object> objects =
-      outcome.GetResult().GetContents();
-
-  std::vector<std::string> objectsFromAlbum;
-  for (Aws::S3::Model::Object& object : objects) {
-    const auto& key = object.GetKey();
-    const auto& pos = key.find("/");
-    if (pos != std::string::npos) {
-      ret.insert(key.substr(0, pos));
-    }
+  if (stop >= 0) {
+    ::close(stop);
   }
+  ::close(events);
+  pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+  return ok;
+}
 
+sigset_t Cloud::watched() {
+  sigset_t ret;
+  sigemptyset(&ret);
+  sigaddset(&ret, SIGINT);
+  sigaddset(&ret, SIGTERM);
+  sigaddset(&ret, SIGHUP);
   return ret;
 }
+#else
+#error your OS is not supported
+#endif
 
-bool Cloud::del(
+bool Cloud::upload(
     const std::string& album,
-    const std::string& photo
+    const std::vector<std::filesystem::path>& files,
+    bool packed,
+    std::vector<char>* uploaded
 ) const {
-  const auto albums = this->albums();
-  if (!albums.has_value()) {
-    return false;
+  if (uploaded != nullptr) {
+    uploaded->assign(files.size(), 0);
   }
-  const auto& als = albums.value();
-  if (std::find(als.begin(), als.end(), album) == als.end()) {
+  if (!isAlbumName(album)) {
     return false;
   }
-
-  const auto objects = get(album);
-  if (!objects.has_value()) {
-    return false;
+  /// a photo named like an object of the album itself would replace its
+  /// index, its metadata or its shard manifest
+  for (const auto& file : files) {
+    if (isReserved(file.stem().string())) {
+      return false;
+    }
   }
-  const auto& objs = objects.value();
-  if (std::find(objs.begin(), objs.end(), photo) == objs.end()) {
+  if (packed) {
+    return uploadPacked(album, files, uploaded);
+  }
+  if (files.empty()) {
+    return true;
+  }
+  const auto shards = layout(album, shards_.value());
+  if (!shards.has_value()) {
     return false;
   }
+  std::vector<char> done(files.size(), 0);
+  /// a failed photo stops the upload unless the caller tracks each one
+  const auto keepGoing = uploaded != nullptr;
 
-  Aws::S3::Model::DeleteObjectRequest request;
-  request.WithBucket(bucket_);
-  request.WithKey(album + "/" + photo);
-  Aws::S3::Model::DeleteObjectOutcome outcome =
-      client_.value().DeleteObject(request);
-  if (!outcome.IsSuccess()) {
+  /// the headers are parsed by the worker that reads the photo, right
+  /// before its transfer
+  exif::Index::value_type entries(files.size());
+  for (auto i = 0u; i < files.size(); i++) {
+    entries[i].name = files[i].stem().string();
+  }
+
+  const auto sizes = io::sizes(files);
+  if (!sizes.has_value()) {
     return false;
   }
+  std::vector<std::size_t> small;
+  std::vector<std::size_t> large;
+  for (auto i = 0u; i < files.size(); i++) {
+    (sizes.value()[i] <= pool_->slabSize() ? small : large).push_back(i);
+  }
 
-  return true;
+  /// small files are read in batches, as many at once as there are free
+  /// slabs, so opening, reading and closing them costs three submissions
+  /// per batch instead of three system calls per file
+  const auto batch = std::clamp<std::size_t>(
+      (small.size() + jobs() - 1) / jobs(), 1, READ_BATCH
+  );
+  /// a worker holds no more than its share of the slabs, so no worker is
+  /// left waiting for one while another sits on a whole batch
+  const auto batches = (small.size() + batch - 1) / batch;
+  const auto share = std::max<std::size_t>(
+      jobs() / std::max<std::size_t>(std::min(jobs(), batches), 1), 1
+  );
+  const auto uploadSmall = [&](std::size_t b) {
+    const auto end = std::min(small.size(), (b + 1) * batch);
+    for (auto first = b * batch; first < end;) {
+      std::vector<pool::Slab> slabs;
+      slabs.push_back(pool_->acquire());
+      while (first + slabs.size() < end && slabs.size() < share) {
+        auto slab = pool_->tryAcquire();
+        if (!slab) {
+          break;
+        }
+        slabs.push_back(std::move(slab));
+      }
+      std::vector<std::filesystem::path> paths;
+      std::vector<std::size_t> lengths;
+      std::vector<unsigned char*> buffers;
+      for (auto i = 0u; i < slabs.size(); i++) {
+        paths.push_back(files[small[first + i]]);
+        lengths.push_back(sizes.value()[small[first + i]]);
+        buffers.push_back(slabs[i].data());
+      }
+      std::vector<char> read(slabs.size(), 1);
+      if (!io::readFiles(paths, lengths, buffers)) {
+        if (!keepGoing) {
+          return false;
+        }
+        /// read again one by one to tell which photo failed
+        for (auto i = 0u; i < slabs.size(); i++) {
+          read[i] = io::readFiles({paths[i]}, {lengths[i]}, {buffers[i]});
+        }
+      }
+      for (auto i = 0u; i < slabs.size(); i++) {
+        if (!read[i]) {
+          continue;
+        }
+        auto& entry = entries[small[first + i]];
+        entry.info =
+            exif::parse(buffers[i], lengths[i]).value_or(exif::Info());
+        Headers headers;
+        auto length = lengths[i];
+        if (optimize_.has_value()) {
+          const auto source = md5::digest(buffers[i], lengths[i]);
+          length = optimize(buffers[i], lengths[i]);
+          if (length != lengths[i]) {
+            headers.metadata[std::string(SOURCE_MD5_META)] = md5::hex(source);
+          }
+        }
+        const auto key = photoKey(album, entry.name, shards.value());
+        const auto sent = this->put(key, buffers[i], length, headers);
+        /// the slab goes back as soon as its photo is sent
+        slabs[i] = pool::Slab();
+        if (!sent) {
+          if (!keepGoing) {
+            return false;
+          }
+          continue;
+        }
+        done[small[first + i]] = 1;
+      }
+      first += slabs.size();
+    }
+    return true;
+  };
+  const auto uploadLarge = [&](std::size_t i) {
+    const auto& path = files[large[i]];
+    auto& entry = entries[large[i]];
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return keepGoing;
+    }
+    const auto info = exif::scan(sizes.value()[large[i]], [fd](
+        unsigned char* buffer,
+        std::size_t offset,
+        std::size_t length
+    ) {
+      return util::readAll(fd, buffer, length, offset);
+    });
+    ::close(fd);
+    entry.info = info.value_or(exif::Info());
+    if (!this->put(path, photoKey(album, entry.name, shards.value()))) {
+      return keepGoing;
+    }
+    done[large[i]] = 1;
+    return true;
+  };
+
+  const auto ok = parallel::forEach(batches, jobs(), uploadSmall)
+      && parallel::forEach(large.size(), jobs(), uploadLarge);
+  /// only the photos that made it are recorded; they stay uploaded if the
+  /// metadata is not, 'backfill' records it later
+  exif::Index::value_type recorded;
+  for (auto i = 0u; i < files.size(); i++) {
+    if (done[i]) {
+      recorded.push_back(std::move(entries[i]));
+    }
+  }
+  if (uploaded != nullptr) {
+    *uploaded = done;
+  }
+  const auto recordedOk =
+      recorded.empty() || record(album, std::move(recorded));
+  return ok
+      && std::find(done.begin(), done.end(), 0) == done.end()
+      && recordedOk;
 }
 
-bool Cloud::del(
-    const std::string& album
-) const {
-  const auto albums = this->albums();
-  if (!albums.has_value()) {
+bool Cloud::uploadTar(const std::string& album, int fd) const {
+  if (!isAlbumName(album)) {
     return false;
   }
-  const auto& als = albums.value();
-  if (std::find(als.begin(), als.end(), album) == als.end()) {
+  const auto shards = layout(album, shards_.value());
+  if (!shards.has_value()) {
     return false;
   }
+  tar::Reader reader(fd);
+  exif::Index::value_type entries;
+  for (auto entry = reader.next(); entry.has_value(); entry = reader.next()) {
+    const std::filesystem::path path(entry.value().name);
+    if (!entry.value().regular || !isPhoto(path)) {
+      continue;
+    }
+    if (isReserved(path.stem().string())) {
+      return false;
+    }
+    exif::Entry meta{path.stem().string(), exif::Info()};
+
+    /// parts are handed to the transfer workers in order, each worker reads
+    /// its part from the stream once the previous one is read and uploads
+    /// it while the next worker reads on; a worker waits for its turn
+    /// before it takes a slab, so the one whose part is next always gets one
+    std::mutex mutex;
+    std::condition_variable read;
+    std::size_t position = 0;
+    auto failed = false;
+    const auto turn = [&](std::size_t offset) {
+      std::unique_lock<std::mutex> lock(mutex);
+      read.wait(lock, [&]() { return failed || position == offset; });
+    };
+    const auto fill = [&](
+        unsigned char* buffer,
+        std::size_t offset,
+        std::size_t length
+    ) {
+      std::unique_lock<std::mutex> lock(mutex);
+      failed = failed || position != offset || !reader.read(buffer, length);
+      if (!failed && offset == 0) {
+        meta.info = exif::parse(buffer, length).value_or(exif::Info());
+      }
+      position += length;
+      lock.unlock();
+      read.notify_all();
+      return !failed;
+    };
+    const auto key = photoKey(album, meta.name, shards.value());
+    if (!put(key, entry.value().size, fill, Headers(), nullptr, turn)) {
+      return false;
+    }
+    entries.push_back(std::move(meta));
+  }
+  return reader.good() && record(album, std::move(entries));
+}
+
+bool Cloud::download(
+    const std::string& album,
+    const std::filesystem::path& dir,
+    io::Durability durability
+) const {
+  std::size_t shards = 0;
+  const auto objects = albumObjects(album, &shards);
+  if (!objects.has_value()) {
+    return false;
+  }
+  const auto index = this->index(album, objects.value());
+  if (!index.has_value()) {
+    return false;
+  }
+
+  keys::Keys loose;
+  for (const auto& object : objects.value()) {
+    const auto name = photoName(album, object.key);
+    if (!name.empty() && !isReserved(name)) {
+      loose.push_back(name);
+    }
+  }
+  loose.sort();
+
+  const auto fetchOne = [&](std::size_t i) {
+    const std::string name(loose[i]);
+    return this->fetch(
+        photoKey(album, name, shards), dir / (name + ".jpg"), durability
+    );
+  };
+  const auto fetched = parallel::forEach(loose.size(), jobs(), fetchOne)
+      && fetchPacked(album, index.value(), loose, dir, durability);
+  if (fetched && durability == io::Durability::BATCH) {
+    return io::sync(dir);
+  }
+  return fetched;
+}
+
+std::optional<keys::Keys> Cloud::get(
+  const std::string& album
+) const {
+  const auto shards = this->shards(album);
+  if (!shards.has_value()) {
+    return {};
+  }
+  std::vector<std::string> prefixes{album + "/"};
+  for (auto shard = 0u; shard < shards.value(); shard++) {
+    prefixes.push_back(shardPrefix(shard) + album + "/");
+  }
+
+  /// pages go straight into the keys, the listing is never held as a whole
+  const auto index = indexKey(album);
+  std::mutex mutex;
+  keys::Keys objectsFromAlbum;
+  auto packed = false;
+  const auto collect = [&](const Range&, std::vector<Object>& page) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& object : page) {
+      packed = packed || object.key == index;
+      const auto name = photoName(album, object.key);
+      if (!isReserved(name)) {
+        objectsFromAlbum.push_back(name);
+      }
+    }
+    return true;
+  };
+  if (!list(prefixes, collect)) {
+    return {};
+  }
+
+  if (packed) {
+    const auto data = load(index);
+    if (!data.has_value()) {
+      return {};
+    }
+    const auto parsed = pack::Index::parse(data.value());
+    if (!parsed.has_value()) {
+      return {};
+    }
+    for (const auto& entry : parsed.value().entries()) {
+      objectsFromAlbum.push_back(entry.name);
+    }
+  }
+  objectsFromAlbum.sort();
+  return objectsFromAlbum;
+}
+
+std::optional<exif::Index> Cloud::meta(const std::string& album) const {
+  /// listing the key itself tells a missing index from a failed request
+  const auto objects = this->objects(metaKey(album));
+  if (!objects.has_value()) {
+    return {};
+  }
+  return meta(album, objects.value());
+}
+
+bool Cloud::backfill(const std::string& album) const {
+  const auto objects = albumObjects(album);
+  if (!objects.has_value()) {
+    return false;
+  }
+  const auto index = this->index(album, objects.value());
+  if (!index.has_value()) {
+    return false;
+  }
+  auto meta = this->meta(album);
+  if (!meta.has_value()) {
+    return false;
+  }
+
+  /// a photo is a byte range of its own object or of a pack
+  struct Photo {
+    std::string name;
+    std::string key;
+    std::size_t offset;
+    std::size_t size;
+  };
+  std::vector<Photo> photos;
+  keys::Keys present;
+  for (const auto& object : objects.value()) {
+    const auto name = photoName(album, object.key);
+    if (name.empty() || isReserved(name)) {
+      continue;
+    }
+    present.push_back(name);
+    if (meta.value().find(name) == nullptr) {
+      photos.push_back({name, object.key, 0, object.size});
+    }
+  }
+  present.sort();
+  const auto loose = present.size();
+  for (const auto& entry : index.value().entries()) {
+    if (present.contains(entry.name)) {
+      continue;
+    }
+    if (meta.value().find(entry.name) == nullptr) {
+      photos.push_back({
+          entry.name,
+          packKey(album, entry.pack),
+          static_cast<std::size_t>(entry.offset),
+          static_cast<std::size_t>(entry.length)
+      });
+    }
+  }
+  /// 'present' is only looked up in while it holds the loose photos
+  for (const auto& entry : index.value().entries()) {
+    present.push_back(entry.name);
+  }
+  if (present.size() > loose) {
+    present.sort();
+  }
+
+  /// photos deleted since are dropped on the way
+  std::vector<std::string> stale;
+  for (const auto& entry : meta.value().entries()) {
+    if (!present.contains(entry.name)) {
+      stale.push_back(entry.name);
+    }
+  }
+  if (photos.empty() && stale.empty()) {
+    return true;
+  }
+
+  exif::Index::value_type entries(photos.size());
+  const auto scanOne = [&](std::size_t i) {
+    const auto& photo = photos[i];
+    const auto info = exif::scan(photo.size, [&](
+        unsigned char* buffer,
+        std::size_t offset,
+        std::size_t length
+    ) {
+      const auto got =
+          getRange(photo.key, photo.offset + offset, length, buffer);
+      return got.has_value() && got.value() == length;
+    });
+    entries[i] = {photo.name, info.value_or(exif::Info())};
+    return info.has_value();
+  };
+  if (!parallel::forEach(photos.size(), jobs(), scanOne)) {
+    return false;
+  }
+  /// only the entries found stale here are dropped, photos recorded since
+  /// the listing stay
+  return updateMeta(album, [&](exif::Index& meta) {
+    for (const auto& name : stale) {
+      meta.remove(name);
+    }
+    meta.merge(entries);
+  });
+}
+
+std::optional<keys::Keys> Cloud::albums() const {
+  keys::Keys ret;
+
+  Aws::S3::Model::ListObjectsV2Request request;
+  request.SetBucket(bucket_);
+  /// the storage rolls the keys of an album up into one common prefix, so
+  /// a page holds up to a thousand albums however many photos they have
+  request.SetDelimiter("/");
+
+  while (true) {
+    const auto outcome = listObjects(request);
+    if (!outcome.IsSuccess()) {
+      return {};
+    }
+    const auto& result = outcome.GetResult();
+    for (const auto& common : result.GetCommonPrefixes()) {
+      const std::string_view prefix(common.GetPrefix());
+      if (
+          prefix == SITE_PREFIX
+          || prefix == PROBE_PREFIX
+          || isShardKey(prefix)
+          || prefix.size() < 2
+      ) {
+        continue;
+      }
+      ret.push_back(prefix.substr(0, prefix.size() - 1));
+    }
+    if (!result.GetIsTruncated()) {
+      break;
+    }
+    request.SetContinuationToken(result.GetNextContinuationToken());
+  }
+  ret.sort();
+
+  return ret;
+}
+
+bool Cloud::del(
+    const std::string& album,
+    const std::string& photo
+) const {
+  const auto albums = this->albums();
+  if (!albums.has_value()) {
+    return false;
+  }
+  if (!albums.value().contains(album)) {
+    return false;
+  }
+
+  /// only the objects the photo may be in are looked at, never the listing
+  /// of the album
+  const auto shards = this->shards(album);
+  if (!shards.has_value()) {
+    return false;
+  }
+  auto removed = false;
+  const auto updated = update(indexKey(album), [&](
+      std::optional<std::string>& content
+  ) {
+    if (!content.has_value()) {
+      return true;
+    }
+    auto index = pack::Index::parse(content.value());
+    if (!index.has_value()) {
+      return false;
+    }
+    removed = index.value().remove(photo);
+    content = index.value().serialize();
+    return true;
+  });
+  if (!updated) {
+    return false;
+  }
+  if (removed) {
+    /// the bytes stay in the pack until the album is unpacked
+    return updateMeta(album, [&photo](exif::Index& meta) {
+      meta.remove(photo);
+    });
+  }
+  const auto key = photoKey(album, photo, shards.value());
+  if (isReserved(photo) || !head(key).has_value()) {
+    return false;
+  }
+
+  Aws::S3::Model::DeleteObjectRequest request;
+  request.WithBucket(bucket_);
+  request.WithKey(key);
+  Aws::S3::Model::DeleteObjectOutcome outcome =
+      client_.value().DeleteObject(request);
+  if (!outcome.IsSuccess()) {
+    return false;
+  }
+
+  return updateMeta(album, [&photo](exif::Index& meta) {
+    meta.remove(photo);
+  });
+}
+
+bool Cloud::del(
+    const std::string& album
+) const {
+  const auto albums = this->albums();
+  if (!albums.has_value()) {
+    return false;
+  }
+  if (!albums.value().contains(album)) {
+    return false;
+  }
+
+  const auto objects = albumObjects(album);
+
+  if (!objects.has_value()) {
+    return false;
+  }
+
+  /// the manifest goes last, nothing is left behind unreachable if the
+  /// deletion fails halfway
+  const auto manifest = shardsKey(album);
+  std::vector<std::string> keys;
+  auto sharded = false;
+  for (const auto& object : objects.value()) {
+    if (object.key == manifest) {
+      sharded = true;
+    } else {
+      keys.push_back(object.key);
+    }
+  }
+
+  return del(keys) && (!sharded || del({manifest}));
+}
+
+bool Cloud::copy(const std::string& album, const std::string& to) const {
+  if (album.empty() || !isAlbumName(to) || album == to) {
+    return false;
+  }
+
+  std::size_t sourceShards = 0;
+  const auto objects = albumObjects(album, &sourceShards);
+  if (!objects.has_value() || objects.value().empty()) {
+    return false;
+  }
+  const auto& objs = objects.value();
+  /// an album with a key under '.pack/' that names no pack number is
+  /// refused before anything is copied
+  std::vector<std::uint32_t> packs(objs.size(), 0);
+  for (auto i = 0u; i < objs.size(); i++) {
+    const auto name = photoName(album, objs[i].key);
+    if (name.compare(0, PACK_PREFIX.size(), PACK_PREFIX) != 0) {
+      continue;
+    }
+    const auto end = name.data() + name.size();
+    const auto [last, error] =
+        std::from_chars(name.data() + PACK_PREFIX.size(), end, packs[i]);
+    if (error != std::errc() || last != end) {
+      return false;
+    }
+  }
+  /// photos keep their shard, unless they join an existing album laid out
+  /// differently
+  const auto shards = layout(to, sourceShards);
+  if (!shards.has_value()) {
+    return false;
+  }
+
+  /// pack numbers are per album, so packs of the source are renumbered to
+  /// follow the packs already in the destination and the indices merged
+  const auto source = this->index(album, objs);
+  if (!source.has_value()) {
+    return false;
+  }
+  std::optional<pack::Index> destination = pack::Index();
+  if (source.value().packs() > 0) {
+    const auto existing = this->objects(to + "/");
+    if (!existing.has_value()) {
+      return false;
+    }
+    destination = this->index(to, existing.value());
+    if (!destination.has_value()) {
+      return false;
+    }
+  }
+  const auto shift = destination.value().packs();
+
+  const auto copyOne = [&](std::size_t i) {
+    const auto name = photoName(album, objs[i].key);
+    if (name == INDEX_NAME || name == META_NAME || name == SHARDS_NAME) {
+      return true;
+    }
+    if (isReserved(name)) {
+      return copyObject(
+          objs[i], packKey(to, static_cast<std::uint32_t>(packs[i] + shift))
+      );
+    }
+    return copyObject(objs[i], photoKey(to, name, shards.value()));
+  };
+  if (!parallel::forEach(objs.size(), jobs(), copyOne)) {
+    return false;
+  }
+
+  const auto meta = this->meta(album);
+  if (!meta.has_value() || !record(to, meta.value().entries())) {
+    return false;
+  }
+
+  if (source.value().packs() == 0) {
+    return true;
+  }
+  /// the packs were copied after the ones listed in the destination, a
+  /// packed upload into it since then may have taken the same numbers
+  return update(indexKey(to), [&](std::optional<std::string>& content) {
+    auto index = content.has_value()
+        ? pack::Index::parse(content.value())
+        : pack::Index();
+    if (!index.has_value() || index.value().packs() != shift) {
+      return false;
+    }
+    index.value().merge(source.value());
+    content = index.value().serialize();
+    return true;
+  });
+}
+
+bool Cloud::move(const std::string& album, const std::string& to) const {
+  const auto objects = albumObjects(album);
+  if (!objects.has_value()) {
+    return false;
+  }
+
+  if (!copy(album, to)) {
+    return false;
+  }
+
+  /// only what was listed before the copy is removed, photos uploaded into
+  /// the source album meanwhile stay there
+  std::vector<std::string> keys;
+  for (const auto& object : objects.value()) {
+    keys.push_back(object.key);
+  }
+  return del(keys);
+}
+
+bool Cloud::unpack(const std::string& album) const {
+  std::size_t shards = 0;
+  const auto objects = albumObjects(album, &shards);
+  if (!objects.has_value()) {
+    return false;
+  }
+  const auto index = this->index(album, objects.value());
+  if (!index.has_value()) {
+    return false;
+  }
+  if (index.value().packs() == 0) {
+    return true;
+  }
+
+  keys::Keys loose;
+  std::vector<std::string> packs;
+  for (const auto& object : objects.value()) {
+    const auto name = photoName(album, object.key);
+    if (!isReserved(name)) {
+      loose.push_back(name);
+    } else if (
+        name != INDEX_NAME && name != META_NAME && name != SHARDS_NAME
+    ) {
+      packs.push_back(object.key);
+    }
+  }
+  loose.sort();
+
+  /// a single part multipart upload may be of any size, so every photo is
+  /// cut out of its pack with one UploadPartCopy
+  const auto& entries = index.value().entries();
+  const auto unpackOne = [&](std::size_t i) {
+    const auto& entry = entries[i];
+    if (loose.contains(entry.name)) {
+      return true;
+    }
+    const auto key = photoKey(album, entry.name, shards);
+    if (entry.length == 0) {
+      return put(std::string(), key);
+    }
+    return copyRange(
+        packKey(album, entry.pack), entry.offset, entry.length, key
+    );
+  };
+  if (!parallel::forEach(entries.size(), jobs(), unpackOne)) {
+    return false;
+  }
+
+  return del({indexKey(album)}) && del(packs);
+}
+
+bool Cloud::mirror(const std::string& album, const Cloud& destination) const {
+  /// the manifest of a sharded album is mirrored along with its shards
+  const auto objects = album.empty()
+      ? this->objects(std::string())
+      : albumObjects(album);
+  if (!objects.has_value()) {
+    return false;
+  }
+  const auto existing = album.empty()
+      ? destination.objects(std::string())
+      : destination.albumObjects(album);
+  if (!existing.has_value()) {
+    return false;
+  }
+  std::map<std::string, std::string> etags;
+  for (const auto& object : existing.value()) {
+    etags.emplace(object.key, object.etag);
+  }
+
+  /// an ETag depends on how the object was put, so a copy whose ETag
+  /// differs is checked against the source ETag it was stored with
+  std::vector<const Object*> toMirror;
+  std::vector<char> changed;
+  for (const auto& object : objects.value()) {
+    const auto found = etags.find(object.key);
+    if (found == etags.end() || found->second != object.etag) {
+      toMirror.push_back(&object);
+      changed.push_back(found != etags.end());
+    }
+  }
+  const std::string sourceEtag(SOURCE_ETAG_META);
+
+  /// every part is a ranged GET on this side written straight into a slab of
+  /// the destination's pool and sent as the body of the destination's PUT,
+  /// with the headers stored along (the encoding and type of site pages)
+  const auto mirrorOne = [&](std::size_t i) {
+    const auto& object = *toMirror[i];
+    if (changed[i]) {
+      const auto stored = destination.head(object.key);
+      if (stored.has_value()) {
+        const auto found = stored.value().metadata.find(sourceEtag);
+        if (
+            found != stored.value().metadata.end()
+            && found->second == object.etag
+        ) {
+          return true;
+        }
+      }
+    }
+    if (object.size > 0 && object.size <= destination.pool_->slabSize()) {
+      /// the GET of a small object brings its headers
+      auto slab = destination.pool_->acquire();
+      Headers headers;
+      for (std::size_t done = 0; done < object.size;) {
+        const auto got = getRange(
+            object.key,
+            done,
+            object.size - done,
+            slab.data() + done,
+            nullptr,
+            done == 0 ? &headers : nullptr
+        );
+        if (!got.has_value() || got.value() == 0) {
+          return false;
+        }
+        done += got.value();
+      }
+      headers.metadata[sourceEtag] = object.etag;
+      return destination.put(object.key, slab.data(), object.size, headers);
+    }
+    auto headers = head(object.key);
+    if (!headers.has_value()) {
+      return false;
+    }
+    headers.value().metadata[sourceEtag] = object.etag;
+    return destination.put(object.key, object.size, [&](
+        unsigned char* buffer,
+        std::size_t offset,
+        std::size_t length
+    ) {
+      while (length > 0) {
+        const auto got = getRange(object.key, offset, length, buffer);
+        if (!got.has_value() || got.value() == 0) {
+          return false;
+        }
+        buffer += got.value();
+        offset += got.value();
+        length -= got.value();
+      }
+      return true;
+    }, headers.value());
+  };
+  return parallel::forEach(toMirror.size(), jobs(), mirrorOne);
+}
+
+std::optional<Report> Cloud::verify(
+    const std::string& album,
+    const std::filesystem::path& dir
+) const {
+  const auto objects = albumObjects(album);
+  if (!objects.has_value()) {
+    return {};
+  }
+  const auto index = this->index(album, objects.value());
+  if (!index.has_value()) {
+    return {};
+  }
+
+  std::map<std::string, std::string> etags;
+  std::map<std::string, std::string> keys;
+  for (const auto& object : objects.value()) {
+    const auto name = photoName(album, object.key);
+    if (name.empty() || isReserved(name)) {
+      continue;
+    }
+    auto etag = object.etag;
+    etag.erase(std::remove(etag.begin(), etag.end(), '"'), etag.end());
+    etags.emplace(name, etag);
+    keys.emplace(name, object.key);
+  }
+  std::map<std::string, md5::Digest> packed;
+  for (const auto& entry : index.value().entries()) {
+    if (etags.count(entry.name) == 0) {
+      packed.emplace(entry.name, entry.hash);
+    }
+  }
+
+  Report report;
+  std::map<std::string, std::filesystem::path> local;
+  for (const auto& path : photos(dir)) {
+    const auto name = path.stem().string();
+    if (etags.count(name) == 0 && packed.count(name) == 0) {
+      report.missing.push_back(name);
+    } else {
+      local.emplace(name, path);
+    }
+  }
+  for (const auto& [name, etag] : etags) {
+    if (local.count(name) == 0) {
+      report.extra.push_back(name);
+    }
+  }
+  for (const auto& [name, hash] : packed) {
+    if (local.count(name) == 0) {
+      report.extra.push_back(name);
+    }
+  }
+
+  const std::vector<std::pair<std::string, std::filesystem::path>> toCheck(
+      local.begin(), local.end()
+  );
+  std::vector<char> mismatched(toCheck.size(), 0);
+  std::vector<char> unverifiable(toCheck.size(), 0);
+  const std::string sourceMd5(SOURCE_MD5_META);
+  const auto checkOne = [&](std::size_t i) {
+    const auto& [name, path] = toCheck[i];
+    const mapped::File file(path);
+    if (!file) {
+      return false;
+    }
+    if (packed.count(name) > 0) {
+      mismatched[i] = util::digest(file) != packed.at(name);
+      return true;
+    }
+    const auto& etag = etags.at(name);
+    const auto dash = etag.find('-');
+    if (dash == std::string::npos) {
+      const auto hash = md5::hex(util::digest(file));
+      if (hash == etag) {
+        return true;
+      }
+      /// an optimized photo tells the MD5 of its source in its metadata
+      const auto stored = head(keys.at(name));
+      if (!stored.has_value()) {
+        return false;
+      }
+      const auto found = stored.value().metadata.find(sourceMd5);
+      mismatched[i] = found == stored.value().metadata.end()
+          || found->second != hash;
+      return true;
+    }
+    /// the part size is not in the listing, it is ours (or the default
+    /// one, for photos uploaded before calibration) if that gives the same
+    /// number of parts, otherwise the smallest whole number of MiB
+    std::size_t parts = 0;
+    const auto end = etag.data() + etag.size();
+    const auto [last, error] =
+        std::from_chars(etag.data() + dash + 1, end, parts);
+    if (error != std::errc() || last != end || parts == 0) {
+      unverifiable[i] = 1;
+      return true;
+    }
+    const auto size = std::max<std::size_t>(file.size(), 1);
+    auto partSize = pool_->slabSize();
+    if ((size + partSize - 1) / partSize != parts) {
+      partSize = PART_SIZE;
+    }
+    if ((size + partSize - 1) / partSize != parts) {
+      partSize = (size + parts - 1) / parts;
+      partSize = (partSize + MEBIBYTE - 1) / MEBIBYTE * MEBIBYTE;
+    }
+    mismatched[i] = util::multipartEtag(file, partSize) != etag;
+    return true;
+  };
+  const auto workers = std::max(1u, std::thread::hardware_concurrency());
+  if (!parallel::forEach(toCheck.size(), workers, checkOne)) {
+    return {};
+  }
+  for (auto i = 0u; i < toCheck.size(); i++) {
+    if (mismatched[i]) {
+      report.mismatched.push_back(toCheck[i].first);
+    }
+    if (unverifiable[i]) {
+      report.unverifiable.push_back(toCheck[i].first);
+    }
+  }
+
+  return report;
+}
+
+std::string Cloud::mksite(
+    bool vendor,
+    std::vector<std::string>* packed
+) const {
+  constexpr std::string_view indexTemplatedVar =
+      "<li><a href=\"album#{id}.html\">#{name}</a></li>";
+
+  constexpr std::string_view albumTemplatedVar =
+      "<img src=\"#{url}\" data-title=\"#{name}\""
+      " data-description=\"#{description}\">";
+
+  // const std::string bucketPolicyBody = "{\n"
+  //     // "   \"Version\":\"2012-10-17\",\n"
+  //     "   \"Statement\":[\n"
+  //     "       {\n"
+  //     // "           \"Sid\": \"mksite\",\n"
+  //     "           \"Effect\": \"Allow\",\n"
+  //     "           \"Principal\": \"*\",\n"
+  //     // "           \"Action\": [\n"
+  //     // "               \"s3:GetObject\"\n"
+  //     // "               \"s3:PutObject\"\n"
+  //     // "               \"s3:GetObjectVersion\"\n"
+  //     // "           ],\n"
+  //     "           \"Action\": \"*\",\n"
+  //     "           \"Resource\": [\n"
+  //     "               \"arn:aws:s3:::" + bucket_ + "/*\",\n"
+  //     "               \"arn:aws:s3:::" + bucket_ + "\"\n"
+  //     "           ]\n"
+  //     "       }\n"
+  //     "   ]\n"
+  //     "}";
+
+  // {
+  //   std::shared_ptr<Aws::StringStream> requestBody =
+  //       Aws::MakeShared<Aws::StringStream>("");
+  //   *requestBody << bucketPolicyBody;
+  //
+  //   Aws::S3::Model::PutBucketPolicyRequest request;
+  //   request.SetBucket(bucket_);
+  //   request.SetBody(requestBody);
+  //
+  //   Aws::S3::Model::PutBucketPolicyOutcome outcome =
+  //       client_.value().PutBucketPolicy(request);
+  //
+  //   if (!outcome.IsSuccess()) {
+  //    // return "PutBucketPolicy Error: " + outcome.GetError().GetMessage();
+  //     return std::string();
+  //   }
+  // }
+
+  // {
+  //   const auto outcome = client_.value().PutPublicAccessBlock(
+  //     Aws::S3::Model::PutPublicAccessBlockRequest()
+  //         .WithPublicAccessBlockConfiguration(
+  //             Aws::S3::Model::PublicAccessBlockConfiguration()
+  //                 .WithBlockPublicAcls(false)
+  //                 .WithIgnorePublicAcls(false)
+  //                 .WithBlockPublicPolicy(false)
+  //                 .WithRestrictPublicBuckets(false)
+  //         )
+  //         .WithBucket(bucket_)
+  //   );
+  //   if (!outcome.IsSuccess()) {
+  //    // return "PutPublicAccessBlock Error: " + outcome.GetError().GetMessage();
+  //     return std::string();
+  //   }
+  // }
+
+  const auto optionalAlbums = this->albums();
+  if (!optionalAlbums.has_value()) {
+    return std::string();
+  }
+  const auto& albums = optionalAlbums.value();
+
+  /// every album is listed at once, before the bucket is made public; only
+  /// the photo names are kept of each page, so the listing of the bucket is
+  /// never held as a whole
+  struct Listing {
+    keys::Keys photos;
+    std::size_t shards = 0;
+    bool packed = false;
+    bool meta = false;
+    bool sharded = false;
+  };
+  std::vector<std::string> names(albums.begin(), albums.end());
+  std::vector<Listing> listed(names.size());
+  std::vector<std::string> prefixes;
+  std::vector<std::size_t> owners;
+  std::mutex mutex;
+  const auto collect = [&](const Range& range, std::vector<Object>& page) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto i = owners[range.prefix];
+    auto& listing = listed[i];
+    for (const auto& object : page) {
+      const auto photo = photoName(names[i], object.key);
+      if (photo == INDEX_NAME) {
+        listing.packed = true;
+      } else if (photo == META_NAME) {
+        listing.meta = true;
+      } else if (photo == SHARDS_NAME) {
+        listing.sharded = true;
+      } else if (!photo.empty() && !isReserved(photo)) {
+        listing.photos.push_back(photo);
+      }
+    }
+    return true;
+  };
+  for (auto i = 0u; i < names.size(); i++) {
+    prefixes.push_back(names[i] + "/");
+    owners.push_back(i);
+  }
+  if (!list(prefixes, collect)) {
+    return std::string();
+  }
+
+  /// a packed album is left as the user chose, 'unpack' turns it into
+  /// objects a page can link
+  auto refused = false;
+  for (auto i = 0u; i < names.size(); i++) {
+    if (listed[i].packed) {
+      refused = true;
+      if (packed != nullptr) {
+        packed->push_back(names[i]);
+      }
+    }
+  }
+  if (refused) {
+    return std::string();
+  }
+
+  /// the shards of every sharded album are listed together
+  const auto loadShards = [&](std::size_t i) {
+    if (!listed[i].sharded) {
+      return true;
+    }
+    const auto count = shards(names[i]);
+    if (!count.has_value()) {
+      return false;
+    }
+    listed[i].shards = count.value();
+    return true;
+  };
+  if (!parallel::forEach(names.size(), jobs(), loadShards)) {
+    return std::string();
+  }
+  prefixes.clear();
+  owners.clear();
+  for (auto i = 0u; i < names.size(); i++) {
+    for (auto shard = 0u; shard < listed[i].shards; shard++) {
+      prefixes.push_back(shardPrefix(shard) + names[i] + "/");
+      owners.push_back(i);
+    }
+  }
+  if (!prefixes.empty() && !list(prefixes, collect)) {
+    return std::string();
+  }
+  for (auto& listing : listed) {
+    listing.photos.sort();
+  }
+
+  {
+    const auto outcome = client_.value().PutBucketAcl(
+      Aws::S3::Model::PutBucketAclRequest()
+          .WithBucket(bucket_)
+          .WithACL(Aws::S3::Model::BucketCannedACL::public_read)
+    );
+    if (!outcome.IsSuccess()) {
+      // return "PutBucketACl Error: " + outcome.GetError().GetMessage();
+      return std::string();
+    }
+  }
+
+  {
+    Aws::S3::Model::IndexDocument indexDoc;
+    indexDoc.SetSuffix("index.html");
+
+    Aws::S3::Model::ErrorDocument errorDoc;
+    errorDoc.SetKey("error.html");
+
+    Aws::S3::Model::WebsiteConfiguration websiteConfig;
+    websiteConfig.SetIndexDocument(indexDoc);
+    websiteConfig.SetErrorDocument(errorDoc);
+
+    Aws::S3::Model::PutBucketWebsiteRequest request;
+    request.SetBucket(bucket_);
+    request.SetWebsiteConfiguration(websiteConfig);
+
+    Aws::S3::Model::PutBucketWebsiteOutcome outcome =
+        client_.value().PutBucketWebsite(request);
+
+    if (!outcome.IsSuccess()) {
+      // return "PutBucketWebsite Error: " + outcome.GetError().GetMessage();
+      return std::string();
+    }
+  }
+
+  // const auto resources = std::map
+
+  std::vector<exif::Index> metas(names.size());
+  const auto loadMeta = [&](std::size_t i) {
+    if (!listed[i].meta) {
+      return true;
+    }
+    const auto data = load(metaKey(names[i]));
+    if (!data.has_value()) {
+      return false;
+    }
+    auto meta = exif::Index::parse(data.value());
+    if (!meta.has_value()) {
+      return false;
+    }
+    metas[i] = std::move(meta.value());
+    return true;
+  };
+  if (!parallel::forEach(names.size(), jobs(), loadMeta)) {
+    return std::string();
+  }
+
+  std::vector<SiteFile> assets;
+  std::string albumTemplate = read("resources/album.html");
+  if (vendor && !this->vendor(albumTemplate, assets)) {
+    return std::string();
+  }
+  const Headers pageHeaders{
+    contentType("index.html"), "", std::string(PAGE_CACHE_CONTROL), {}
+  };
+  std::vector<SiteFile> pages;
+
+  {
+    {
+      auto it = albums.begin();
+      for (auto i = 1u; i <= albums.size(); i++, it++) {
+        const std::string name(*it);
+        const auto& listing = listed[i - 1];
+        const auto& meta = metas[i - 1];
+
+        /// photos are shown in the order they were taken, the ones of
+        /// unknown date last
+        std::vector<std::pair<std::string, const exif::Info*>> objects;
+        const exif::Info unknown;
+        for (const auto obj : listing.photos) {
+          const auto* info = meta.find(obj);
+          objects.emplace_back(obj, info == nullptr ? &unknown : info);
+        }
+        std::stable_sort(
+            objects.begin(),
+            objects.end(),
+            [](const auto& lhs, const auto& rhs) {
+              return !lhs.second->date.empty() && (
+                  rhs.second->date.empty()
+                  || lhs.second->date < rhs.second->date
+              );
+            }
+        );
+
+        /// a large album is split into pages linked to each other
+        const auto count = std::max<std::size_t>(
+            (objects.size() + SITE_PAGE_SIZE - 1) / SITE_PAGE_SIZE, 1
+        );
+        for (auto page = 0u; page < count; page++) {
+          std::string linksToPhotos;
+          const auto first = objects.begin() + page * SITE_PAGE_SIZE;
+          const auto last = objects.begin()
+              + std::min(objects.size(), (page + 1) * SITE_PAGE_SIZE);
+          for (auto object = first; object != last; object++) {
+            const auto& [obj, info] = *object;
+            std::string description = exif::isoDate(info->date);
+            if (info->width > 0) {
+              description += (description.empty() ? "" : ", ")
+                  + std::to_string(info->width)
+                  + "x" + std::to_string(info->height);
+            }
+            if (!info->camera.empty()) {
+              description += (description.empty() ? "" : ", ") + info->camera;
+            }
+            std::string link(albumTemplatedVar);
+            const auto safeUrl = util::urlEncode(
+                photoKey(name, std::string(obj), listing.shards)
+            );
+            util::replace(link, "#{url}", safeUrl);
+            util::replace(link, "#{name}", obj);
+            util::replace(
+                link, "#{description}", util::htmlEscape(description)
+            );
+            linksToPhotos += (link + "\n");
+          }
+
+          std::string navigation;
+          if (count > 1) {
+            if (page > 0) {
+              navigation += "<a href=\"" + pageKey(i, page - 1)
+                  + "\">&larr;</a> ";
+            }
+            navigation += std::to_string(page + 1)
+                + " / " + std::to_string(count);
+            if (page + 1 < count) {
+              navigation += " <a href=\"" + pageKey(i, page + 1)
+                  + "\">&rarr;</a>";
+            }
+          }
+
+          std::string album = albumTemplate;
+          util::replace(album, "#{linksToPhotos}", linksToPhotos);
+          util::replace(album, "#{pages}", navigation);
+          pages.push_back(
+              {pageKey(i, page), util::minifyHtml(album), pageHeaders}
+          );
+        }
+      }
+    }
+  }
+
+  {
+    std::string linksToAlbums;
+    {
+      auto it = albums.begin();
+      for (auto i = 1u; i <= albums.size(); i++, it++) {
+        std::string link(indexTemplatedVar);
+        util::replace(link, "#{id}", std::to_string(i));
+        util::replace(link, "#{name}", std::string(*it));
+        linksToAlbums += (link + "\n");
+      }
+    }
+
+    std::string index = read("resources/index.html");
+    util::replace(index, "#{linksToAlbums}", linksToAlbums);
+    pages.push_back({"index.html", util::minifyHtml(index), pageHeaders});
+  }
+
+  pages.push_back({
+    "error.html",
+    util::minifyHtml(read(std::filesystem::path("resources") / "error.html")),
+    pageHeaders
+  });
+
+  /// assets are named by their content, the ones already in the bucket are
+  /// the same; they go first so that no page refers to a missing one
+  const auto published = this->objects(std::string(SITE_PREFIX));
+  if (!published.has_value()) {
+    return std::string();
+  }
+  keys::Keys present;
+  for (const auto& object : published.value()) {
+    present.push_back(object.key);
+  }
+  present.sort();
+  if (!publish(assets, present) || !publish(pages, keys::Keys())) {
+    return std::string();
+  }
+
+  return
+      std::string("https://")
+      + bucket_
+      + std::string(".website.yandexcloud.net/");
+}
+
+std::optional<Profile> Cloud::calibrate() const {
+  const auto prefix = std::string(PROBE_PREFIX);
+  std::optional<Profile> best;
+  Probe fastest;
+  /// candidates within the memory limit only, the best one so far stays
+  /// unless clearly beaten
+  const auto tryProfile = [&](const Profile& candidate) {
+    const auto transfers = std::max<std::size_t>(candidate.concurrency, 1);
+    if (transfers * candidate.partSize > maxMemory_.value()) {
+      return;
+    }
+    const auto probe = this->probe(candidate, prefix);
+    if (
+        probe.has_value()
+        && (!best.has_value()
+            || probe.value().rate > fastest.rate * (1 + PROBE_MARGIN))
+    ) {
+      best = candidate;
+      fastest = probe.value();
+    }
+  };
+
+  /// timeouts of the SDK while probing, a tight calibrated one could fail
+  /// the very candidates that would replace it
+  Profile candidate;
+  candidate.tcpKeepAliveMs = profile_.value().tcpKeepAliveMs;
+  for (const std::size_t concurrency : {2, 4, 8, 16, 32, 64}) {
+    candidate.concurrency = concurrency;
+    candidate.maxConnections = concurrency;
+    tryProfile(candidate);
+  }
+  if (!best.has_value()) {
+    return {};
+  }
+  candidate = best.value();
+  for (const auto partSize : {MIN_PART_SIZE, 2 * PART_SIZE}) {
+    candidate.partSize = partSize;
+    tryProfile(candidate);
+  }
+  /// spare connections serve listings and retries next to the transfers
+  candidate = best.value();
+  candidate.maxConnections = 2 * candidate.concurrency;
+  tryProfile(candidate);
+
+  auto ret = best.value();
+  ret.requestTimeoutMs = std::max<std::size_t>(
+      ret.requestTimeoutMs, TIMEOUT_FACTOR * fastest.slowest.count()
+  );
+  ret.connectTimeoutMs = std::max<std::size_t>(
+      ret.connectTimeoutMs, TIMEOUT_FACTOR * fastest.connect.count()
+  );
+  if (!saveProfile(ret)) {
+    return {};
+  }
+  /// leftovers are harmless, albums skip them and the next run overwrites
+  /// them
+  const auto scratch = objects(prefix);
+  if (scratch.has_value()) {
+    std::vector<std::string> keys;
+    for (const auto& object : scratch.value()) {
+      keys.push_back(object.key);
+    }
+    del(keys);
+  }
+  return ret;
+}
+
+std::optional<Cloud::Probe> Cloud::probe(
+    const Profile& profile,
+    const std::string& prefix
+) const {
+  const auto since = [](std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start
+    );
+  };
+  Probe ret;
+  Cloud cloud(configFile_);
+  cloud.setMaxMemory(maxMemory_.value());
+  /// the endpoint is measured, not the configured limits
+  cloud.setLimitRate(0, 0);
+  cloud.setProfile(profile);
+  const auto start = std::chrono::steady_clock::now();
+  if (!cloud.init()) {
+    cloud.deinit();
+    return {};
+  }
+  ret.connect = since(start);
+
+  std::mutex mutex;
+  const auto timed = [&](const std::function<bool()>& request) {
+    const auto begin = std::chrono::steady_clock::now();
+    const auto ok = request();
+    const auto took = since(begin);
+    std::lock_guard<std::mutex> lock(mutex);
+    ret.slowest = std::max(ret.slowest, took);
+    return ok;
+  };
+  const auto fill = [](
+      unsigned char* buffer,
+      std::size_t offset,
+      std::size_t length
+  ) {
+    /// xorshift seeded by the offset, parts may be filled in any order
+    std::uint64_t state = offset + 1;
+    for (auto i = 0u; i < length; i++) {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      buffer[i] = static_cast<unsigned char>(state);
+    }
+    return true;
+  };
+  const auto photoKey = [&prefix](std::size_t i) {
+    return prefix + std::to_string(i);
+  };
+  const auto largeKey = prefix + "large";
+  const auto partSize = cloud.pool_->slabSize();
+  const auto parts = (PROBE_LARGE_SIZE + partSize - 1) / partSize;
+
+  const auto putPhoto = [&](std::size_t i) {
+    auto slab = cloud.pool_->acquire();
+    fill(slab.data(), i * PROBE_PHOTO_SIZE, PROBE_PHOTO_SIZE);
+    return timed([&]() {
+      return cloud.put(photoKey(i), slab.data(), PROBE_PHOTO_SIZE);
+    });
+  };
+  const auto getPhoto = [&](std::size_t i) {
+    auto slab = cloud.pool_->acquire();
+    return timed([&]() {
+      return cloud.getRange(photoKey(i), 0, PROBE_PHOTO_SIZE, slab.data())
+          == PROBE_PHOTO_SIZE;
+    });
+  };
+  const auto getPart = [&](std::size_t i) {
+    auto slab = cloud.pool_->acquire();
+    const auto offset = i * partSize;
+    const auto length = std::min(partSize, PROBE_LARGE_SIZE - offset);
+    return timed([&]() {
+      return cloud.getRange(largeKey, offset, length, slab.data()) == length;
+    });
+  };
+  const auto transfers = std::chrono::steady_clock::now();
+  const auto ok = parallel::forEach(PROBE_PHOTOS, cloud.jobs(), putPhoto)
+      && cloud.put(largeKey, PROBE_LARGE_SIZE, fill)
+      && parallel::forEach(PROBE_PHOTOS, cloud.jobs(), getPhoto)
+      && parallel::forEach(parts, cloud.jobs(), getPart);
+  const auto elapsed = std::max<std::chrono::milliseconds::rep>(
+      since(transfers).count(), 1
+  );
+  cloud.deinit();
+  if (!ok) {
+    return {};
+  }
+  /// everything went up and came back down
+  const auto bytes = 2 * (PROBE_PHOTOS * PROBE_PHOTO_SIZE + PROBE_LARGE_SIZE);
+  ret.rate = static_cast<double>(bytes) * 1000 / elapsed;
+  return ret;
+}
+
+bool Cloud::configure(
+    const std::string& keyId,
+    const std::string& key,
+    const std::string& bucket,
+    const std::string& region,
+    const std::string& endpoint
+) {
+  const auto progHomeDir = std::filesystem::path(configFile_).parent_path();
+  if (!std::filesystem::is_directory(progHomeDir.string())) {
+    if (!std::filesystem::create_directories(progHomeDir.string())) {
+      return false;
+    }
+  }
+
+  const auto toIniLine = [](const std::string& key, const std::string& val) {
+    return key + " = " + val;
+  };
+
+  {
+    std::ofstream config = std::ofstream(std::string(configFile_));
+    std::stringstream ss;
+    ss << std::string("[DEFAULT]\n")
+        << (toIniLine(std::string(BUCKET_KEY), bucket) + "\n")
+        << (toIniLine(std::string(KEY_ID_KEY), keyId) + "\n")
+        << (toIniLine(std::string(SECRET_KEY_KEY), key) + "\n")
+        << (toIniLine(std::string(REGION_KEY), region) + "\n")
+        << (toIniLine(std::string(ENDPOINT_KEY), endpoint) + "\n")
+    ;
+    config << ss.str().data();
+    config.close();
+  }
+
+  return true;
+}
+
+bool Cloud::put(const std::string& data, std::string key) const {
+  return put(key, data.size(), [&data](
+      unsigned char* buffer,
+      std::size_t offset,
+      std::size_t length
+  ) {
+    std::memcpy(buffer, data.data() + offset, length);
+    return true;
+  });
+}
+
+bool Cloud::put(const std::filesystem::path& path, std::string key) const {
+  std::error_code error;
+  const auto size = std::filesystem::file_size(path, error);
+  if (error) {
+    return false;
+  }
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  const auto ok = put(key, size, [fd](
+      unsigned char* buffer,
+      std::size_t offset,
+      std::size_t length
+  ) {
+    return util::readAll(fd, buffer, length, offset);
+  });
+  ::close(fd);
+  return ok;
+}
+
+bool Cloud::put(
+    const std::string& key,
+    std::size_t size,
+    const Filler& fill,
+    const Headers& headers,
+    Precondition* precondition,
+    const Turn& turn
+) const {
+  const auto partSize = pool_->slabSize();
+
+  if (size <= partSize) {
+    if (turn) {
+      turn(0);
+    }
+    auto slab = pool_->acquire();
+    if (!fill(slab.data(), 0, size)) {
+      return false;
+    }
+    return put(key, slab.data(), size, headers, precondition);
+  }
+
+  std::string uploadId;
+  {
+    Aws::S3::Model::CreateMultipartUploadRequest request;
+    request.SetBucket(bucket_);
+    request.SetKey(key);
+    setHeaders(request, headers);
+    const auto outcome = client_.value().CreateMultipartUpload(request);
+    if (!outcome.IsSuccess()) {
+      return false;
+    }
+    uploadId = outcome.GetResult().GetUploadId();
+  }
+
+  const auto parts = (size + partSize - 1) / partSize;
+  std::vector<Aws::S3::Model::CompletedPart> completed(parts);
+  const auto uploaded = parallel::forEach(parts, jobs(), [&](std::size_t i) {
+    const auto offset = i * partSize;
+    const auto length = std::min(partSize, size - offset);
+    if (turn) {
+      turn(offset);
+    }
+    auto slab = pool_->acquire();
+    if (!fill(slab.data(), offset, length)) {
+      return false;
+    }
+    rate::Scope scope(rate::Priority::BULK);
+    Aws::S3::Model::UploadPartRequest request;
+    request.SetBucket(bucket_);
+    request.SetKey(key);
+    request.SetUploadId(uploadId);
+    request.SetPartNumber(static_cast<int>(i + 1));
+    request.SetContentLength(length);
+    request.SetBody(Aws::MakeShared<SlabStream>("", slab.data(), length));
+    const auto outcome = client_.value().UploadPart(request);
+    if (!outcome.IsSuccess()) {
+      return false;
+    }
+    completed[i].SetPartNumber(static_cast<int>(i + 1));
+    completed[i].SetETag(outcome.GetResult().GetETag());
+    report(key, length);
+    return true;
+  });
+
+  if (!uploaded) {
+    Aws::S3::Model::AbortMultipartUploadRequest request;
+    request.SetBucket(bucket_);
+    request.SetKey(key);
+    request.SetUploadId(uploadId);
+    client_.value().AbortMultipartUpload(request);
+    return false;
+  }
+
+  Aws::S3::Model::CompletedMultipartUpload upload;
+  upload.SetParts(completed);
+  Aws::S3::Model::CompleteMultipartUploadRequest request;
+  request.SetBucket(bucket_);
+  request.SetKey(key);
+  request.SetUploadId(uploadId);
+  request.SetMultipartUpload(upload);
+  if (precondition != nullptr) {
+    if (precondition->etag.empty()) {
+      request.SetIfNoneMatch("*");
+    } else {
+      request.SetIfMatch(precondition->etag);
+    }
+  }
+  const auto outcome = client_.value().CompleteMultipartUpload(request);
+  if (!outcome.IsSuccess()) {
+    if (precondition != nullptr) {
+      precondition->conflict = isConflict(outcome.GetError());
+    }
+    /// the parts of a refused upload would be kept and billed otherwise
+    Aws::S3::Model::AbortMultipartUploadRequest abort;
+    abort.SetBucket(bucket_);
+    abort.SetKey(key);
+    abort.SetUploadId(uploadId);
+    client_.value().AbortMultipartUpload(abort);
+    return false;
+  }
+  return true;
+}
+
+bool Cloud::put(
+    const std::string& key,
+    const unsigned char* data,
+    std::size_t size,
+    const Headers& headers,
+    Precondition* precondition
+) const {
+  rate::Scope scope(
+      size >= BULK_SIZE ? rate::Priority::BULK : rate::Priority::INTERACTIVE
+  );
+  Aws::S3::Model::PutObjectRequest request;
+  request.SetBucket(bucket_);
+  request.SetKey(key);
+  request.SetContentLength(size);
+  setHeaders(request, headers);
+  if (precondition != nullptr) {
+    if (precondition->etag.empty()) {
+      request.SetIfNoneMatch("*");
+    } else {
+      request.SetIfMatch(precondition->etag);
+    }
+  }
+  request.SetBody(Aws::MakeShared<SlabStream>(
+      "", const_cast<unsigned char*>(data), size
+  ));
+  const auto outcome = client_.value().PutObject(request);
+  if (!outcome.IsSuccess()) {
+    if (precondition != nullptr) {
+      precondition->conflict = isConflict(outcome.GetError());
+    }
+    return false;
+  }
+  report(key, size);
+  return true;
+}
+
+bool Cloud::update(
+    const std::string& key,
+    const std::function<bool(std::optional<std::string>& content)>& change
+) const {
+  for (auto attempt = 0u; attempt < UPDATE_ATTEMPTS; attempt++) {
+    Precondition precondition;
+    std::optional<std::string> current;
+    {
+      Aws::S3::Model::GetObjectRequest request;
+      request.SetBucket(bucket_);
+      request.SetKey(key);
+      auto outcome = client_.value().GetObject(request);
+      if (outcome.IsSuccess()) {
+        auto& result = outcome.GetResultWithOwnership();
+        precondition.etag = result.GetETag();
+        auto& body = result.GetBody();
+        current = std::string(std::istreambuf_iterator<char>(body), {});
+      } else if (
+          outcome.GetError().GetResponseCode()
+          != Aws::Http::HttpResponseCode::NOT_FOUND
+      ) {
+        return false;
+      }
+    }
+    auto content = current;
+    if (!change(content)) {
+      return false;
+    }
+    if (content == current) {
+      return true;
+    }
+    if (!content.has_value()) {
+      return false;
+    }
+    const auto& data = content.value();
+    const auto written = put(key, data.size(), [&data](
+        unsigned char* buffer,
+        std::size_t offset,
+        std::size_t length
+    ) {
+      std::memcpy(buffer, data.data() + offset, length);
+      return true;
+    }, Headers(), &precondition);
+    if (written) {
+      return true;
+    }
+    if (!precondition.conflict) {
+      return false;
+    }
+  }
+  return false;
+}
+
+bool Cloud::isConflict(const Aws::S3::S3Error& error) {
+  /// 409 is a conditional write racing another one on the same key
+  const auto code = error.GetResponseCode();
+  return code == Aws::Http::HttpResponseCode::PRECONDITION_FAILED
+      || code == Aws::Http::HttpResponseCode::CONFLICT;
+}
+
+bool Cloud::fetch(
+    const std::string& key,
+    const std::filesystem::path& path,
+    io::Durability durability
+) const {
+  const auto partSize = pool_->slabSize();
+  const int fd = ::open(
+      path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644
+  );
+  if (fd < 0) {
+    return false;
+  }
+
+  /// every part is a ranged GET that fits exactly into one slab, the first
+  /// one also tells the total object size through 'Content-Range'
+  const auto getPart = [&](std::size_t offset, std::size_t* total) {
+    auto slab = pool_->acquire();
+    const auto got = getRange(key, offset, partSize, slab.data(), total);
+    return got.has_value()
+        && util::writeAll(fd, slab.data(), got.value(), offset);
+  };
+
+  std::size_t total = 0;
+  auto ok = getPart(0, &total);
+  if (ok && total > partSize) {
+    const auto parts = (total + partSize - 1) / partSize;
+    ok = parallel::forEach(parts - 1, jobs(), [&](std::size_t i) {
+      return getPart((i + 1) * partSize, nullptr);
+    });
+  }
+  if (ok && durability == io::Durability::FILE) {
+    ok = ::fsync(fd) == 0;
+  }
+
+  ok = (::close(fd) == 0) && ok;
+  if (!ok) {
+    /// no truncated photo is left behind to pass for a downloaded one
+    std::error_code error;
+    std::filesystem::remove(path, error);
+  }
+  return ok;
+}
+
+std::optional<std::size_t> Cloud::getRange(
+    const std::string& key,
+    std::size_t offset,
+    std::size_t length,
+    unsigned char* buffer,
+    std::size_t* total,
+    Headers* headers
+) const {
+  /// an empty range can not be written as one
+  if (length == 0) {
+    return 0;
+  }
+  const auto size = std::min(length, pool_->slabSize());
+  rate::Scope scope(
+      size >= BULK_SIZE ? rate::Priority::BULK : rate::Priority::INTERACTIVE
+  );
+  Aws::S3::Model::GetObjectRequest request;
+  request.SetBucket(bucket_);
+  request.SetKey(key);
+  request.SetRange(
+      "bytes=" + std::to_string(offset)
+      + "-" + std::to_string(offset + size - 1)
+  );
+  request.SetResponseStreamFactory([buffer, size]() {
+    return Aws::New<SlabStream>("", buffer, size);
+  });
+  const auto outcome = client_.value().GetObject(request);
+  if (!outcome.IsSuccess()) {
+    /// an empty object has no byte 0, any range of it is refused
+    if (
+        offset == 0
+        && outcome.GetError().GetResponseCode()
+            == Aws::Http::HttpResponseCode::REQUESTED_RANGE_NOT_SATISFIABLE
+    ) {
+      if (total != nullptr) {
+        *total = 0;
+      }
+      return 0;
+    }
+    return {};
+  }
+  if (total != nullptr) {
+    const auto& range = outcome.GetResult().GetContentRange();
+    const auto slash = range.rfind('/');
+    *total = static_cast<std::size_t>(outcome.GetResult().GetContentLength());
+    if (slash != std::string::npos) {
+      const auto end = range.data() + range.size();
+      const auto [last, error] =
+          std::from_chars(range.data() + slash + 1, end, *total);
+      if (error != std::errc() || last != end) {
+        return {};
+      }
+    }
+  }
+  if (headers != nullptr) {
+    *headers = getHeaders(outcome.GetResult());
+  }
+  const auto got =
+      static_cast<std::size_t>(outcome.GetResult().GetContentLength());
+  report(key, got);
+  return got;
+}
+
+std::optional<Headers> Cloud::head(const std::string& key) const {
+  Aws::S3::Model::HeadObjectRequest request;
+  request.SetBucket(bucket_);
+  request.SetKey(key);
+  const auto outcome = client_.value().HeadObject(request);
+  if (!outcome.IsSuccess()) {
+    return {};
+  }
+  return getHeaders(outcome.GetResult());
+}
+
+template <typename Request>
+void Cloud::setHeaders(Request& request, const Headers& headers) {
+  if (!headers.contentType.empty()) {
+    request.SetContentType(headers.contentType);
+  }
+  if (!headers.contentEncoding.empty()) {
+    request.SetContentEncoding(headers.contentEncoding);
+  }
+  if (!headers.cacheControl.empty()) {
+    request.SetCacheControl(headers.cacheControl);
+  }
+  for (const auto& [name, value] : headers.metadata) {
+    request.AddMetadata(name, value);
+  }
+}
+
+template <typename Result>
+Headers Cloud::getHeaders(const Result& result) {
+  Headers ret;
+  ret.contentType = result.GetContentType();
+  ret.contentEncoding = result.GetContentEncoding();
+  ret.cacheControl = result.GetCacheControl();
+  for (const auto& [name, value] : result.GetMetadata()) {
+    ret.metadata.emplace(name, value);
+  }
+  return ret;
+}
+
+std::optional<std::string> Cloud::load(const std::string& key) const {
+  Aws::S3::Model::GetObjectRequest request;
+  request.SetBucket(bucket_);
+  request.SetKey(key);
+  auto outcome = client_.value().GetObject(request);
+  if (!outcome.IsSuccess()) {
+    return {};
+  }
+  auto& body = outcome.GetResultWithOwnership().GetBody();
+  return std::string(std::istreambuf_iterator<char>(body), {});
+}
+
+std::optional<std::vector<Object>> Cloud::objects(
+    const std::string& prefix
+) const {
+  auto listed = objects(std::vector<std::string>{prefix});
+  if (!listed.has_value()) {
+    return {};
+  }
+  return std::move(listed.value()[0]);
+}
 
-  Aws::S3::Model::DeleteObjectRequest request;
-  request.WithBucket(bucket_);
+std::optional<std::vector<std::vector<Object>>> Cloud::objects(
+    const std::vector<std::string>& prefixes
+) const {
+  /// the pieces of a prefix by where they start, which is their order
+  std::mutex mutex;
+  std::vector<std::map<std::string, std::vector<Object>>> pieces(
+      prefixes.size()
+  );
+  const auto collect = [&](const Range& range, std::vector<Object>& page) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& piece = pieces[range.prefix][range.after];
+    piece.insert(
+        piece.end(),
+        std::make_move_iterator(page.begin()),
+        std::make_move_iterator(page.end())
+    );
+    return true;
+  };
+  if (!list(prefixes, collect)) {
+    return {};
+  }
+
+  std::vector<std::vector<Object>> ret(prefixes.size());
+  for (auto i = 0u; i < prefixes.size(); i++) {
+    for (auto& [after, objects] : pieces[i]) {
+      ret[i].insert(
+          ret[i].end(),
+          std::make_move_iterator(objects.begin()),
+          std::make_move_iterator(objects.end())
+      );
+    }
+  }
+  return ret;
+}
 
-  const auto photos = this->get(album);
+Aws::S3::Model::ListObjectsV2Outcome Cloud::listObjects(
+    const Aws::S3::Model::ListObjectsV2Request& request
+) const {
+  return client_.value().ListObjectsV2(request);
+}
 
-  if (!photos.has_value()) {
-    return false;
+bool Cloud::list(
+    const std::vector<std::string>& prefixes,
+    const std::function<bool(const Range& range, std::vector<Object>& page)>&
+        visit
+) const {
+  std::vector<Range> ranges;
+  for (auto i = 0u; i < prefixes.size(); i++) {
+    ranges.push_back({i, std::string(), std::string()});
+  }
+  const auto listRange = [&](Range& range, parallel::Queue<Range>& queue) {
+    Aws::S3::Model::ListObjectsV2Request request;
+    request.SetBucket(bucket_);
+    request.SetPrefix(prefixes[range.prefix]);
+    auto after = range.after;
+    while (true) {
+      if (!after.empty()) {
+        request.SetStartAfter(after);
+      }
+      const auto outcome = listObjects(request);
+      if (!outcome.IsSuccess()) {
+        return false;
+      }
+      const auto& result = outcome.GetResult();
+      std::vector<Object> page;
+      auto end = !result.GetIsTruncated();
+      for (const auto& object : result.GetContents()) {
+        if (!range.last.empty() && object.GetKey() > range.last) {
+          end = true;
+          break;
+        }
+        page.push_back({
+            object.GetKey(),
+            static_cast<std::size_t>(object.GetSize()),
+            object.GetETag()
+        });
+      }
+      if (page.empty()) {
+        break;
+      }
+      const auto first = page.front().key;
+      after = page.back().key;
+      if (!visit(range, page)) {
+        return false;
+      }
+      if (end) {
+        break;
+      }
+      /// idle workers take over the rest of the range in pieces, this one
+      /// goes on with the first
+      const auto bounds = split(first, after, range.last, queue.spare());
+      for (auto i = 0u; i < bounds.size(); i++) {
+        queue.push({
+            range.prefix,
+            bounds[i],
+            i + 1 < bounds.size() ? bounds[i + 1] : range.last
+        });
+      }
+      if (!bounds.empty()) {
+        range.last = bounds[0];
+      }
+    }
+    return true;
+  };
+  return parallel::drain(std::move(ranges), jobs(), listRange);
+}
+
+std::optional<std::vector<Object>> Cloud::albumObjects(
+    const std::string& album,
+    std::size_t* shards
+) const {
+  auto listed = albumObjects(std::vector<std::string>{album});
+  if (!listed.has_value()) {
+    return {};
   }
+  if (shards != nullptr) {
+    *shards = listed.value()[0].shards;
+  }
+  return std::move(listed.value()[0].objects);
+}
 
-  for (const auto& key : photos.value()) {
-    request.WithKey(album + "/" + key);
-    Aws::S3::Model::DeleteObjectOutcome outcome =
-        client_.value().DeleteObject(request);
-    if (!outcome.IsSuccess()) {
+std::optional<std::vector<Cloud::Album>> Cloud::albumObjects(
+    const std::vector<std::string>& albums
+) const {
+  std::vector<std::string> prefixes;
+  for (const auto& album : albums) {
+    prefixes.push_back(album + "/");
+  }
+  auto listed = objects(prefixes);
+  if (!listed.has_value()) {
+    return {};
+  }
+
+  std::vector<Album> ret(albums.size());
+  const auto loadShards = [&](std::size_t i) {
+    const auto count = shards(albums[i], listed.value()[i]);
+    if (!count.has_value()) {
       return false;
     }
+    ret[i].shards = count.value();
+    ret[i].objects = std::move(listed.value()[i]);
+    return true;
+  };
+  if (!parallel::forEach(albums.size(), jobs(), loadShards)) {
+    return {};
   }
 
-  return true;
+  /// the shards of every sharded album are listed together
+  prefixes.clear();
+  std::vector<std::size_t> owners;
+  for (auto i = 0u; i < albums.size(); i++) {
+    for (auto shard = 0u; shard < ret[i].shards; shard++) {
+      prefixes.push_back(shardPrefix(shard) + albums[i] + "/");
+      owners.push_back(i);
+    }
+  }
+  if (prefixes.empty()) {
+    return ret;
+  }
+  listed = objects(prefixes);
+  if (!listed.has_value()) {
+    return {};
+  }
+  for (auto i = 0u; i < prefixes.size(); i++) {
+    auto& objects = ret[owners[i]].objects;
+    objects.insert(
+        objects.end(),
+        std::make_move_iterator(listed.value()[i].begin()),
+        std::make_move_iterator(listed.value()[i].end())
+    );
+  }
+  return ret;
 }
 
-std::string Cloud::mksite() const {
-  constexpr std::string_view indexTemplatedVar =
-      "<li><a href=\"album#{id}.html\">#{name}</a></li>";
+std::vector<std::string> Cloud::split(
+    const std::string& first,
+    const std::string& after,
+    const std::string& last,
+    std::size_t count
+) {
+  /// the keys of the page differ first at 'position', the bounds vary the
+  /// byte there between the one of 'after' and the one of 'last', within
+  /// ASCII so that they stay valid UTF-8
+  const auto position = static_cast<std::size_t>(std::mismatch(
+      first.begin(), first.end(), after.begin(), after.end()
+  ).first - first.begin());
+  if (count == 0 || position >= after.size()) {
+    return {};
+  }
+  /// names mostly vary in digits or letters, the bounds stay among the
+  /// ones of the byte's class and the last range takes everything beyond
+  const auto byte = static_cast<unsigned char>(after[position]);
+  const std::size_t low = byte + 1;
+  std::size_t high = std::isdigit(byte) ? '9' + 1
+      : std::isupper(byte) ? 'Z' + 1
+      : std::islower(byte) ? 'z' + 1
+      : 0x80;
+  if (
+      last.size() > position
+      && last.compare(0, position, after, 0, position) == 0
+  ) {
+    high = std::min<std::size_t>(
+        high, static_cast<unsigned char>(last[position])
+    );
+  }
+  if (high <= low) {
+    return {};
+  }
+  count = std::min(count, high - low);
+  std::vector<std::string> ret;
+  for (auto i = 0u; i < count; i++) {
+    ret.push_back(
+        after.substr(0, position)
+        + static_cast<char>(low + (high - low) * i / count)
+    );
+  }
+  return ret;
+}
 
-  constexpr std::string_view albumTemplatedVar =
-      "<img src=\"#{url}\" data-title=\"#{name}\">";
+bool Cloud::copyObject(const Object& source, const std::string& key) const {
+  auto copySource = util::urlEncode(bucket_ + "/" + source.key);
+  util::replace(copySource, "%2F", "/");
 
-  // const std::string bucketPolicyBody = "{\n"
-  //     // "   \"Version\":\"2012-10-17\",\n"
-  //     "   \"Statement\":[\n"
-  //     "       {\n"
-  //     // "           \"Sid\": \"mksite\",\n"
-  //     "           \"Effect\": \"Allow\",\n"
-  //     "           \"Principal\": \"*\",\n"
-  //     // "           \"Action\": [\n"
-  //     // "               \"s3:GetObject\"\n"
-  //     // "               \"s3:PutObject\"\n"
-  //     // "               \"s3:GetObjectVersion\"\n"
-  //     // "           ],\n"
-  //     "           \"Action\": \"*\",\n"
-  //     "           \"Resource\": [\n"
-  //     "               \"arn:aws:s3:::" + bucket_ + "/*\",\n"
-  //     "               \"arn:aws:s3:::" + bucket_ + "\"\n"
-  //     "           ]\n"
-  //     "       }\n"
-  //     "   ]\n"
-  //     "}";
+  if (source.size <= MAX_COPY_SIZE) {
+    Aws::S3::Model::CopyObjectRequest request;
+    request.SetBucket(bucket_);
+    request.SetKey(key);
+    request.SetCopySource(copySource);
+    const auto outcome = client_.value().CopyObject(request);
+    return outcome.IsSuccess();
+  }
 
-  // {
-  //   std::shared_ptr<Aws::StringStream> requestBody =
-  //       Aws::MakeShared<Aws::StringStream>("");
-  //   *requestBody << bucketPolicyBody;
-  //
-  //   Aws::S3::Model::PutBucketPolicyRequest request;
-  //   request.SetBucket(bucket_);
-  //   request.SetBody(requestBody);
-  //
-  //   Aws::S3::Model::PutBucketPolicyOutcome outcome =
-  //       client_.value().PutBucketPolicy(request);
-  //
-  //   if (!outcome.IsSuccess()) {
-  //    // return "PutBucketPolicy Error: " + outcome.GetError().GetMessage();
-  //     return std::string();
-  //   }
-  // }
+  /// CopyObject keeps the headers, a multipart copy has to be given them
+  const auto headers = head(source.key);
+  return headers.has_value()
+      && copyRange(source.key, 0, source.size, key, headers.value());
+}
 
-  // {
-  //   const auto outcome = client_.value().PutPublicAccessBlock(
-  //     Aws::S3::Model::PutPublicAccessBlockRequest()
-  //         .WithPublicAccessBlockConfiguration(
-  //             Aws::S3::Model::PublicAccessBlockConfiguration()
-  //                 .WithBlockPublicAcls(false)
-  //                 .WithIgnorePublicAcls(false)
-  //                 .WithBlockPublicPolicy(false)
-  //                 .WithRestrictPublicBuckets(false)
-  //         )
-  //         .WithBucket(bucket_)
-  //   );
-  //   if (!outcome.IsSuccess()) {
-  //    // return "PutPublicAccessBlock Error: " + outcome.GetError().GetMessage();
-  //     return std::string();
-  //   }
-  // }
+bool Cloud::copyRange(
+    const std::string& source,
+    std::size_t offset,
+    std::size_t length,
+    const std::string& key,
+    const Headers& headers
+) const {
+  auto copySource = util::urlEncode(bucket_ + "/" + source);
+  util::replace(copySource, "%2F", "/");
 
+  std::string uploadId;
   {
-    const auto outcome = client_.value().PutBucketAcl(
-      Aws::S3::Model::PutBucketAclRequest()
-          .WithBucket(bucket_)
-          .WithACL(Aws::S3::Model::BucketCannedACL::public_read)
-    );
+    Aws::S3::Model::CreateMultipartUploadRequest request;
+    request.SetBucket(bucket_);
+    request.SetKey(key);
+    setHeaders(request, headers);
+    const auto outcome = client_.value().CreateMultipartUpload(request);
     if (!outcome.IsSuccess()) {
-      // return "PutBucketACl Error: " + outcome.GetError().GetMessage();
-      return std::string();
+      return false;
     }
+    uploadId = outcome.GetResult().GetUploadId();
   }
 
-  {
-    Aws::S3::Model::IndexDocument indexDoc;
-    indexDoc.SetSuffix("index.html");
+  const auto parts = (length + COPY_PART_SIZE - 1) / COPY_PART_SIZE;
+  std::vector<Aws::S3::Model::CompletedPart> completed(parts);
+  const auto copied = parallel::forEach(parts, jobs(), [&](std::size_t i) {
+    const auto first = offset + i * COPY_PART_SIZE;
+    const auto last = std::min(first + COPY_PART_SIZE, offset + length) - 1;
+    Aws::S3::Model::UploadPartCopyRequest request;
+    request.SetBucket(bucket_);
+    request.SetKey(key);
+    request.SetUploadId(uploadId);
+    request.SetPartNumber(static_cast<int>(i + 1));
+    request.SetCopySource(copySource);
+    request.SetCopySourceRange(
+        "bytes=" + std::to_string(first) + "-" + std::to_string(last)
+    );
+    const auto outcome = client_.value().UploadPartCopy(request);
+    if (!outcome.IsSuccess()) {
+      return false;
+    }
+    completed[i].SetPartNumber(static_cast<int>(i + 1));
+    completed[i].SetETag(outcome.GetResult().GetCopyPartResult().GetETag());
+    return true;
+  });
 
-    Aws::S3::Model::ErrorDocument errorDoc;
-    errorDoc.SetKey("error.html");
+  if (!copied) {
+    Aws::S3::Model::AbortMultipartUploadRequest request;
+    request.SetBucket(bucket_);
+    request.SetKey(key);
+    request.SetUploadId(uploadId);
+    client_.value().AbortMultipartUpload(request);
+    return false;
+  }
 
-    Aws::S3::Model::WebsiteConfiguration websiteConfig;
-    websiteConfig.SetIndexDocument(indexDoc);
-    websiteConfig.SetErrorDocument(errorDoc);
+  Aws::S3::Model::CompletedMultipartUpload upload;
+  upload.SetParts(completed);
+  Aws::S3::Model::CompleteMultipartUploadRequest request;
+  request.SetBucket(bucket_);
+  request.SetKey(key);
+  request.SetUploadId(uploadId);
+  request.SetMultipartUpload(upload);
+  const auto outcome = client_.value().CompleteMultipartUpload(request);
+  return outcome.IsSuccess();
+}
 
-    Aws::S3::Model::PutBucketWebsiteRequest request;
+bool Cloud::del(const std::vector<std::string>& keys) const {
+  const auto batches =
+      (keys.size() + DELETE_BATCH_SIZE - 1) / DELETE_BATCH_SIZE;
+  return parallel::forEach(batches, jobs(), [&](std::size_t i) {
+    Aws::S3::Model::Delete batch;
+    batch.SetQuiet(true);
+    const auto end = std::min(keys.size(), (i + 1) * DELETE_BATCH_SIZE);
+    for (auto j = i * DELETE_BATCH_SIZE; j < end; j++) {
+      batch.AddObjects(Aws::S3::Model::ObjectIdentifier().WithKey(keys[j]));
+    }
+    Aws::S3::Model::DeleteObjectsRequest request;
     request.SetBucket(bucket_);
-    request.SetWebsiteConfiguration(websiteConfig);
+    request.SetDelete(batch);
+    const auto outcome = client_.value().DeleteObjects(request);
+    return outcome.IsSuccess() && outcome.GetResult().GetErrors().empty();
+  });
+}
 
-    Aws::S3::Model::PutBucketWebsiteOutcome outcome =
-        client_.value().PutBucketWebsite(request);
+std::optional<std::string> Cloud::fetchUrl(const std::string& url) const {
+  const auto http =
+      Aws::Http::CreateHttpClient(Aws::Client::ClientConfiguration());
+  const auto request = Aws::Http::CreateHttpRequest(
+      Aws::Http::URI(url),
+      Aws::Http::HttpMethod::HTTP_GET,
+      Aws::Utils::Stream::DefaultResponseStreamFactoryMethod
+  );
+  const auto response = http->MakeRequest(request);
+  if (
+      response == nullptr
+      || response->GetResponseCode() != Aws::Http::HttpResponseCode::OK
+  ) {
+    return {};
+  }
+  std::ostringstream body;
+  body << response->GetResponseBody().rdbuf();
+  return body.str();
+}
+
+bool Cloud::vendor(std::string& page, std::vector<SiteFile>& assets) const {
+  constexpr std::string_view scheme = "https://";
+  for (const std::string attribute : {"src=\"", "href=\""}) {
+    for (
+        auto pos = page.find(attribute + std::string(scheme));
+        pos != std::string::npos;
+        pos = page.find(attribute + std::string(scheme), pos)
+    ) {
+      const auto begin = pos + attribute.size();
+      const auto end = page.find('"', begin);
+      if (end == std::string::npos) {
+        return false;
+      }
+      const auto key = vendorAsset(page.substr(begin, end - begin), assets);
+      if (key.empty()) {
+        return false;
+      }
+      page.replace(begin, end - begin, key);
+      pos = begin + key.size();
+    }
+  }
+  return true;
+}
+
+std::string Cloud::vendorAsset(
+    const std::string& url,
+    std::vector<SiteFile>& assets
+) const {
+  auto body = fetchUrl(url);
+  if (!body.has_value()) {
+    return std::string();
+  }
+  const auto path = url.substr(0, url.find_first_of("?#"));
+  const auto name = path.substr(path.rfind('/') + 1);
+  const auto type = contentType(name);
+
+  /// relative references of a style sheet are vendored as well; every
+  /// asset is one directory below 'SITE_PREFIX', so the copies are one
+  /// directory up
+  if (type.compare(0, 8, "text/css") == 0) {
+    auto& css = body.value();
+    for (auto pos = css.find("url("); pos != std::string::npos;) {
+      auto begin = pos + 4;
+      const auto quote = css[begin] == '"' || css[begin] == '\''
+          ? css[begin] : ')';
+      begin += quote == ')' ? 0 : 1;
+      const auto end = css.find(quote, begin);
+      if (end == std::string::npos) {
+        break;
+      }
+      const auto reference = css.substr(begin, end - begin);
+      pos = css.find("url(", end);
+      if (
+          reference.empty()
+          || reference.compare(0, 5, "data:") == 0
+          || reference.find("//") != std::string::npos
+          || reference[0] == '/'
+          || reference[0] == '#'
+      ) {
+        continue;
+      }
+      const auto key = vendorAsset(
+          path.substr(0, path.rfind('/') + 1) + reference, assets
+      );
+      if (key.empty()) {
+        return std::string();
+      }
+      const auto relative = "../" + key.substr(SITE_PREFIX.size());
+      css.replace(begin, end - begin, relative);
+      pos = css.find("url(", begin + relative.size());
+    }
+  }
+
+  const auto& content = body.value();
+  const auto hash = md5::hex(md5::digest(content.data(), content.size()));
+  const auto key = std::string(SITE_PREFIX)
+      + hash.substr(0, SITE_HASH_LENGTH) + "/" + name;
+  const auto known = std::any_of(
+      assets.begin(),
+      assets.end(),
+      [&key](const auto& asset) { return asset.key == key; }
+  );
+  if (!known) {
+    assets.push_back({
+      key,
+      std::move(body.value()),
+      {type, "", std::string(ASSET_CACHE_CONTROL), {}}
+    });
+  }
+  return key;
+}
+
+bool Cloud::publish(
+    const std::vector<SiteFile>& files,
+    const keys::Keys& skip
+) const {
+  const auto publishOne = [&](std::size_t i) {
+    const auto& file = files[i];
+    if (skip.contains(file.key)) {
+      return true;
+    }
+    auto headers = file.headers;
+    const auto text = headers.contentType.compare(0, 5, "text/") == 0
+        || headers.contentType == "image/svg+xml";
+    /// the website endpoint can not negotiate, so everything compressed is
+    /// gzip, which every client accepts
+    std::optional<std::string> compressed;
+    if (text) {
+      compressed = gzip::compress(file.body);
+      if (!compressed.has_value()) {
+        return false;
+      }
+      if (compressed.value().size() < file.body.size()) {
+        headers.contentEncoding = "gzip";
+      } else {
+        compressed.reset();
+      }
+    }
+    const auto& body = compressed.has_value() ? compressed.value() : file.body;
+    return put(
+        file.key,
+        reinterpret_cast<const unsigned char*>(body.data()),
+        body.size(),
+        headers
+    );
+  };
+  return parallel::forEach(files.size(), jobs(), publishOne);
+}
+
+std::string Cloud::contentType(std::string_view key) {
+  const std::map<std::string_view, std::string_view> types {
+    {".html", "text/html; charset=utf-8"},
+    {".css", "text/css; charset=utf-8"},
+    {".js", "text/javascript; charset=utf-8"},
+    {".json", "application/json"},
+    {".svg", "image/svg+xml"},
+    {".png", "image/png"},
+    {".gif", "image/gif"},
+    {".jpg", "image/jpeg"},
+    {".jpeg", "image/jpeg"},
+    {".woff", "font/woff"},
+    {".woff2", "font/woff2"},
+  };
+  const auto dot = key.rfind('.');
+  const auto type = dot == std::string_view::npos
+      ? types.end()
+      : types.find(key.substr(dot));
+  return std::string(
+      type == types.end() ? "application/octet-stream" : type->second
+  );
+}
+
+std::string Cloud::pageKey(std::size_t album, std::size_t page) {
+  return "album" + std::to_string(album)
+      + (page == 0 ? std::string() : "-" + std::to_string(page + 1))
+      + ".html";
+}
+
+bool Cloud::uploadPacked(
+    const std::string& album,
+    const std::vector<std::filesystem::path>& files,
+    std::vector<char>* uploaded
+) const {
+  if (files.empty()) {
+    return true;
+  }
+
+  const auto objects = this->objects(album + "/");
+  if (!objects.has_value()) {
+    return false;
+  }
+  const auto index = this->index(album, objects.value());
+  if (!index.has_value()) {
+    return false;
+  }
+
+  pack::Index::value_type entries(files.size());
+  exif::Index::value_type meta(files.size());
+  const auto hashFile = [&](std::size_t i) {
+    std::error_code error;
+    const auto size = std::filesystem::file_size(files[i], error);
+    if (error) {
+      return false;
+    }
+    const int fd = ::open(files[i].c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+    auto slab = pool_->acquire();
+    md5::Md5 hash;
+    auto ok = true;
+    for (std::size_t offset = 0; ok && offset < size;) {
+      const auto length = std::min(slab.capacity(), size - offset);
+      ok = util::readAll(fd, slab.data(), length, offset);
+      hash.update(slab.data(), length);
+      if (ok && offset == 0) {
+        meta[i].info =
+            exif::parse(slab.data(), length).value_or(exif::Info());
+      }
+      offset += length;
+    }
+    ::close(fd);
+    entries[i].name = files[i].stem().string();
+    meta[i].name = entries[i].name;
+    entries[i].length = size;
+    entries[i].hash = hash.digest();
+    return ok;
+  };
+  std::vector<char> hashed(files.size(), 0);
+  const auto hashOne = [&](std::size_t i) {
+    hashed[i] = hashFile(i);
+    return hashed[i] || uploaded != nullptr;
+  };
+  if (!parallel::forEach(files.size(), jobs(), hashOne)) {
+    return false;
+  }
+  /// photos that can not be read are left out of the packs when the caller
+  /// tracks each photo
+  std::vector<std::filesystem::path> paths;
+  std::vector<std::size_t> kept;
+  for (auto i = 0u; i < files.size(); i++) {
+    if (hashed[i]) {
+      if (kept.size() < i) {
+        entries[kept.size()] = std::move(entries[i]);
+        meta[kept.size()] = std::move(meta[i]);
+      }
+      paths.push_back(files[i]);
+      kept.push_back(i);
+    }
+  }
+  entries.resize(kept.size());
+  meta.resize(kept.size());
+  if (kept.empty()) {
+    return false;
+  }
+
+  /// photos are laid out back to back, a pack is closed once the next photo
+  /// would make it exceed 'PACK_SIZE'
+  std::vector<std::pair<std::size_t, std::size_t>> groups;
+  {
+    std::size_t first = 0;
+    std::size_t size = 0;
+    for (auto i = 0u; i < entries.size(); i++) {
+      if (i > first && size + entries[i].length > PACK_SIZE) {
+        groups.emplace_back(first, i);
+        first = i;
+        size = 0;
+      }
+      entries[i].offset = size;
+      size += entries[i].length;
+    }
+    groups.emplace_back(first, entries.size());
+  }
+
+  /// a pack is only created, never replaced: a number another writer took
+  /// meanwhile is skipped for the next one
+  std::vector<std::uint32_t> ids;
+  auto next = index.value().packs();
+  for (const auto& [begin, end] : groups) {
+    const auto size = entries[end - 1].offset + entries[end - 1].length;
+    const auto fill = [&, begin = begin, end = end](
+        unsigned char* buffer,
+        std::size_t offset,
+        std::size_t length
+    ) {
+      auto i = static_cast<std::size_t>(std::partition_point(
+          entries.begin() + begin,
+          entries.begin() + end,
+          [offset](const pack::Entry& entry) {
+            return entry.offset + entry.length <= offset;
+          }
+      ) - entries.begin());
+      for (; length > 0 && i < end; i++) {
+        const auto inner = offset - entries[i].offset;
+        const auto size =
+            std::min<std::size_t>(length, entries[i].length - inner);
+        const int fd = ::open(paths[i].c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+          return false;
+        }
+        const auto ok = util::readAll(fd, buffer, size, inner);
+        ::close(fd);
+        if (!ok) {
+          return false;
+        }
+        buffer += size;
+        offset += size;
+        length -= size;
+      }
+      return length == 0;
+    };
+    for (;; next++) {
+      Precondition precondition;
+      if (put(packKey(album, next), size, fill, Headers(), &precondition)) {
+        break;
+      }
+      if (!precondition.conflict) {
+        return false;
+      }
+    }
+    ids.push_back(next++);
+  }
 
-    if (!outcome.IsSuccess()) {
-      // return "PutBucketWebsite Error: " + outcome.GetError().GetMessage();
-      return std::string();
+  /// the index goes last, so it never refers to a pack that is not there;
+  /// the packs join the index as it is by then
+  const auto indexed = update(indexKey(album), [&](
+      std::optional<std::string>& content
+  ) {
+    auto index = content.has_value()
+        ? pack::Index::parse(content.value())
+        : pack::Index();
+    if (!index.has_value()) {
+      return false;
+    }
+    for (auto i = 0u; i < groups.size(); i++) {
+      const auto [begin, end] = groups[i];
+      index.value().add(pack::Index::value_type(
+          entries.begin() + begin, entries.begin() + end
+      ), ids[i]);
+    }
+    content = index.value().serialize();
+    return true;
+  });
+  if (!indexed) {
+    return false;
+  }
+  if (uploaded != nullptr) {
+    for (const auto i : kept) {
+      (*uploaded)[i] = 1;
     }
   }
+  return record(album, std::move(meta)) && kept.size() == files.size();
+}
 
-  // const auto resources = std::map
+bool Cloud::fetchPacked(
+    const std::string& album,
+    const pack::Index& index,
+    const keys::Keys& skip,
+    const std::filesystem::path& dir,
+    io::Durability durability
+) const {
+  const auto partSize = pool_->slabSize();
 
-  const auto optionalAlbums = this->albums();
-  if (!optionalAlbums.has_value()) {
-    return std::string();
+  std::vector<const pack::Entry*> sorted;
+  for (const auto& entry : index.entries()) {
+    if (!skip.contains(entry.name)) {
+      sorted.push_back(&entry);
+    }
   }
-  const auto& albums = optionalAlbums.value();
+  std::sort(
+      sorted.begin(),
+      sorted.end(),
+      [](const pack::Entry* lhs, const pack::Entry* rhs) {
+        return std::tie(lhs->pack, lhs->offset)
+            < std::tie(rhs->pack, rhs->offset);
+      }
+  );
 
-  {
-    {
-      auto it = albums.begin();
-      for (auto i = 1u; i <= albums.size(); i++, it++) {
-        const auto optionalObjects = get(*it);
-        if (!optionalObjects.has_value()) {
-          return std::string();
-        }
-        const auto& objects = optionalObjects.value();
-
-        std::string linksToPhotos;
-        for (const auto& obj : objects) {
-          std::string link(albumTemplatedVar);
-          const auto safeUrl = util::urlEncode(*it + "/" + obj);
-          util::replace(link, "#{url}", safeUrl);
-          util::replace(link, "#{name}", obj);
-          linksToPhotos += (link + "\n" + std::string(12, ' '));
-        }
+  /// neighbouring photos of one pack are coalesced into a span that fits a
+  /// slab, a photo larger than a slab is a span of its own
+  struct Span {
+    std::uint32_t pack;
+    std::size_t offset;
+    std::size_t length;
+    std::vector<const pack::Entry*> entries;
+  };
+  std::vector<Span> spans;
+  for (const auto* entry : sorted) {
+    if (!spans.empty()) {
+      auto& last = spans.back();
+      const auto end = last.offset + last.length;
+      if (
+          last.pack == entry->pack
+          && entry->offset >= end
+          && entry->offset - end <= COALESCE_GAP
+          && entry->offset + entry->length - last.offset <= partSize
+      ) {
+        last.length = entry->offset + entry->length - last.offset;
+        last.entries.push_back(entry);
+        continue;
+      }
+    }
+    spans.push_back({
+        entry->pack,
+        static_cast<std::size_t>(entry->offset),
+        static_cast<std::size_t>(entry->length),
+        {entry}
+    });
+  }
 
-        std::string album = read("resources/album.html");
-        util::replace(album, "#{linksToPhotos}", linksToPhotos);
+  return parallel::forEach(spans.size(), jobs(), [&](std::size_t i) {
+    const auto& span = spans[i];
+    const auto key = packKey(album, span.pack);
+    auto slab = pool_->acquire();
 
-        if (!put(album, "album" + std::to_string(i) + ".html")) {
-          return std::string();
+    if (span.length > partSize) {
+      const auto& entry = *span.entries.front();
+      const int fd = ::open(
+          (dir / (entry.name + ".jpg")).c_str(),
+          O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+          0644
+      );
+      if (fd < 0) {
+        return false;
+      }
+      md5::Md5 hash;
+      auto ok = true;
+      for (std::size_t done = 0; ok && done < span.length;) {
+        const auto got = getRange(
+            key, span.offset + done, span.length - done, slab.data()
+        );
+        ok = got.has_value() && got.value() > 0
+            && util::writeAll(fd, slab.data(), got.value(), done);
+        if (ok) {
+          hash.update(slab.data(), got.value());
+          done += got.value();
         }
       }
+      if (ok && durability == io::Durability::FILE) {
+        ok = ::fsync(fd) == 0;
+      }
+      return (::close(fd) == 0) && ok && hash.digest() == entry.hash;
     }
-  }
 
-  {
-    std::string linksToAlbums;
-    {
-      auto it = albums.begin();
-      for (auto i = 1u; i <= albums.size(); i++, it++) {
-        std::string link(indexTemplatedVar);
-        util::replace(link, "#{id}", std::to_string(i));
-        util::replace(link, "#{name}", *it);
-        linksToAlbums += (link + "\n" + std::string(12, ' '));
+    if (span.length > 0) {
+      const auto got = getRange(key, span.offset, span.length, slab.data());
+      if (!got.has_value() || got.value() != span.length) {
+        return false;
+      }
+    }
+    std::vector<std::filesystem::path> paths;
+    std::vector<const unsigned char*> data;
+    std::vector<std::size_t> lengths;
+    for (const auto* entry : span.entries) {
+      const auto* bytes = slab.data() + (entry->offset - span.offset);
+      if (md5::digest(bytes, entry->length) != entry->hash) {
+        return false;
       }
+      paths.push_back(dir / (entry->name + ".jpg"));
+      data.push_back(bytes);
+      lengths.push_back(entry->length);
     }
+    return io::writeFiles(paths, data, lengths, durability);
+  });
+}
 
-    std::string index = read("resources/index.html");
-    util::replace(index, "#{linksToAlbums}", linksToAlbums);
+std::optional<pack::Index> Cloud::index(
+    const std::string& album,
+    const std::vector<Object>& objects
+) const {
+  const auto key = indexKey(album);
+  const auto found = std::find_if(
+      objects.begin(),
+      objects.end(),
+      [&key](const Object& object) { return object.key == key; }
+  );
+  if (found == objects.end()) {
+    return pack::Index();
+  }
+  const auto data = load(key);
+  if (!data.has_value()) {
+    return {};
+  }
+  return pack::Index::parse(data.value());
+}
 
-    if (!put(index, "index.html")) {
-      return std::string();
-    }
+std::optional<exif::Index> Cloud::meta(
+    const std::string& album,
+    const std::vector<Object>& objects
+) const {
+  const auto key = metaKey(album);
+  const auto found = std::find_if(
+      objects.begin(),
+      objects.end(),
+      [&key](const Object& object) { return object.key == key; }
+  );
+  if (found == objects.end()) {
+    return exif::Index();
+  }
+  const auto data = load(key);
+  if (!data.has_value()) {
+    return {};
   }
+  return exif::Index::parse(data.value());
+}
 
-  if (!put(
-      std::filesystem::path("resources") / "error.html",
-      "error.html"
-  )) {
-    return std::string();
+std::optional<std::size_t> Cloud::shards(const std::string& album) const {
+  /// listing the key itself tells an unsharded album from a failed request
+  const auto objects = this->objects(shardsKey(album));
+  if (!objects.has_value()) {
+    return {};
   }
+  return shards(album, objects.value());
+}
 
-  return
-      std::string("https://")
-      + bucket_
-      + std::string(".website.yandexcloud.net/");
+std::optional<std::size_t> Cloud::shards(
+    const std::string& album,
+    const std::vector<Object>& objects
+) const {
+  const auto key = shardsKey(album);
+  const auto found = std::find_if(
+      objects.begin(),
+      objects.end(),
+      [&key](const Object& object) { return object.key == key; }
+  );
+  if (found == objects.end()) {
+    return 0;
+  }
+  const auto data = load(key);
+  if (!data.has_value()) {
+    return {};
+  }
+  const auto count = util::parseSize(
+      data.value().substr(0, data.value().find('\n'))
+  );
+  if (!count.has_value() || count.value() > MAX_SHARDS) {
+    return {};
+  }
+  return count;
 }
 
-bool Cloud::configure(
-    const std::string& keyId,
-    const std::string& key,
-    const std::string& bucket,
-    const std::string& region,
-    const std::string& endpoint
+std::optional<std::size_t> Cloud::layout(
+    const std::string& album,
+    std::size_t create
+) const {
+  const auto shards = this->shards(album);
+  if (!shards.has_value() || shards.value() > 0 || create == 0) {
+    return shards;
+  }
+  /// an album that already has objects keeps its keys
+  Aws::S3::Model::ListObjectsV2Request request;
+  request.SetBucket(bucket_);
+  request.SetPrefix(album + "/");
+  request.SetMaxKeys(1);
+  const auto outcome = listObjects(request);
+  if (!outcome.IsSuccess()) {
+    return {};
+  }
+  if (!outcome.GetResult().GetContents().empty()) {
+    return 0;
+  }
+  if (!put(std::to_string(create) + "\n", shardsKey(album))) {
+    return {};
+  }
+  return create;
+}
+
+bool Cloud::isPhoto(const std::filesystem::path& path) {
+  return path.extension().string() == ".jpg"
+      || path.extension().string() == ".jpeg";
+}
+
+std::vector<std::filesystem::path> Cloud::photos(
+    const std::filesystem::path& dir
 ) {
-  const auto progHomeDir = std::filesystem::path(configFile_).parent_path();
-  if (!std::filesystem::is_directory(progHomeDir.string())) {
-    if (!std::filesystem::create_directories(progHomeDir.string())) {
-      return false;
+  std::vector<std::filesystem::path> ret;
+  for (const auto& file : std::filesystem::directory_iterator(dir)) {
+    if (isPhoto(file.path())) {
+      ret.push_back(file.path());
     }
   }
+  return ret;
+}
 
-  const auto toIniLine = [](const std::string& key, const std::string& val) {
-    return key + " = " + val;
-  };
+bool Cloud::isReserved(std::string_view name) {
+  return name == INDEX_NAME
+      || name == META_NAME
+      || name == SHARDS_NAME
+      || name.compare(0, PACK_PREFIX.size(), PACK_PREFIX) == 0;
+}
 
-  {
-    std::ofstream config = std::ofstream(std::string(configFile_));
-    std::stringstream ss;
-    ss << std::string("[DEFAULT]\n")
-        << (toIniLine(std::string(BUCKET_KEY), bucket) + "\n")
-        << (toIniLine(std::string(KEY_ID_KEY), keyId) + "\n")
-        << (toIniLine(std::string(SECRET_KEY_KEY), key) + "\n")
-        << (toIniLine(std::string(REGION_KEY), region) + "\n")
-        << (toIniLine(std::string(ENDPOINT_KEY), endpoint) + "\n")
-    ;
-    config << ss.str().data();
-    config.close();
+bool Cloud::isShardKey(std::string_view key) {
+  return key.size() > 3
+      && key[0] == '.'
+      && std::isxdigit(static_cast<unsigned char>(key[1]))
+      && std::isxdigit(static_cast<unsigned char>(key[2]))
+      && key[3] == '/';
+}
+
+bool Cloud::isAlbumName(std::string_view album) {
+  return !album.empty() && !isShardKey(std::string(album) + "/");
+}
+
+bool Cloud::isAlbumKey(std::string_view album, std::string_view key) {
+  if (isShardKey(key)) {
+    key.remove_prefix(shardPrefix(0).size());
   }
+  return key.size() > album.size()
+      && key.compare(0, album.size(), album) == 0
+      && key[album.size()] == '/';
+}
 
-  return true;
+std::string Cloud::packKey(const std::string& album, std::uint32_t pack) {
+  return album + "/" + std::string(PACK_PREFIX) + std::to_string(pack);
 }
 
-bool Cloud::put(const std::string& data, std::string key) const {
-  Aws::S3::Model::PutObjectRequest request;
-  request.SetBucket(bucket_);
-  request.SetKey(key);
-  const std::shared_ptr<Aws::IOStream> inputData =
-        Aws::MakeShared<Aws::StringStream>("");
-    *inputData << data.c_str();
-  request.SetBody(inputData);
-  Aws::S3::Model::PutObjectOutcome outcome =
-      client_.value().PutObject(request);
-  if (!outcome.IsSuccess()) {
-    return false;
+std::string Cloud::indexKey(const std::string& album) {
+  return album + "/" + std::string(INDEX_NAME);
+}
+
+std::string Cloud::metaKey(const std::string& album) {
+  return album + "/" + std::string(META_NAME);
+}
+
+std::string Cloud::shardsKey(const std::string& album) {
+  return album + "/" + std::string(SHARDS_NAME);
+}
+
+std::string Cloud::shardPrefix(std::size_t shard) {
+  constexpr char digits[] = "0123456789abcdef";
+  return std::string{'.', digits[shard / 16 % 16], digits[shard % 16], '/'};
+}
+
+std::string Cloud::photoKey(
+    const std::string& album,
+    const std::string& name,
+    std::size_t shards
+) {
+  if (shards == 0) {
+    return album + "/" + name;
   }
+  /// by the name only, so a copied photo stays in its shard
+  const auto digest = md5::digest(name.data(), name.size());
+  return shardPrefix(digest[0] % shards) + album + "/" + name;
+}
 
-  return true;
+std::string Cloud::photoName(
+    const std::string& album,
+    const std::string& key
+) {
+  const std::size_t prefix = isShardKey(key) ? shardPrefix(0).size() : 0;
+  return key.substr(prefix + album.size() + 1);
 }
 
-bool Cloud::put(const std::filesystem::path& path, std::string key) const {
-  Aws::S3::Model::PutObjectRequest request;
-  request.SetBucket(bucket_);
-  request.SetKey(key);
-  std::shared_ptr<Aws::IOStream> inputData =
-      Aws::MakeShared<Aws::FStream>("",
-          path.string().c_str(),
-          std::ios_base::in | std::ios_base::binary);
-  request.SetBody(inputData);
-  Aws::S3::Model::PutObjectOutcome outcome =
-      client_.value().PutObject(request);
-  if (!outcome.IsSuccess()) {
-    return false;
+bool Cloud::record(
+    const std::string& album,
+    exif::Index::value_type entries
+) const {
+  if (entries.empty()) {
+    return true;
+  }
+  return updateMeta(album, [&entries](exif::Index& meta) {
+    meta.merge(entries);
+  });
+}
+
+bool Cloud::updateMeta(
+    const std::string& album,
+    const std::function<void(exif::Index& meta)>& change
+) const {
+  return update(metaKey(album), [&](std::optional<std::string>& content) {
+    auto meta = content.has_value()
+        ? exif::Index::parse(content.value())
+        : exif::Index();
+    if (!meta.has_value()) {
+      return false;
+    }
+    change(meta.value());
+    /// an album without metadata gets none for nothing
+    if (content.has_value() || !meta.value().entries().empty()) {
+      content = meta.value().serialize();
+    }
+    return true;
+  });
+}
+
+std::size_t Cloud::jobs() const {
+  return pool_->slabs();
+}
+
+void Cloud::report(const std::string& key, std::size_t bytes) const {
+  if (progress_) {
+    progress_(key, bytes);
+  }
+}
+
+std::size_t Cloud::optimize(unsigned char* data, std::size_t size) const {
+  optimizing_.acquire();
+  const auto optimized = jpeg::optimize(data, size, optimize_.value());
+  optimizing_.release();
+  if (!optimized.has_value() || optimized.value().size() >= size) {
+    return size;
+  }
+  std::memcpy(data, optimized.value().data(), optimized.value().size());
+  return optimized.value().size();
+}
+
+std::optional<Profile> Cloud::readProfile(const std::string& config) {
+  Profile ret;
+  for (const auto& [key, field] : PROFILE_KEYS) {
+    const auto value = readIniLine(config, std::string(key));
+    if (value.empty()) {
+      continue;
+    }
+    const auto parsed = util::parseSize(value);
+    if (!parsed.has_value()) {
+      return {};
+    }
+    ret.*field = parsed.value();
+  }
+  if (ret.partSize < MIN_PART_SIZE || ret.maxConnections == 0) {
+    return {};
+  }
+  return ret;
+}
+
+bool Cloud::saveProfile(const Profile& profile) const {
+  std::istringstream current(read(configFile_));
+  std::string contents;
+  for (std::string line; std::getline(current, line);) {
+    const auto isProfile = std::any_of(
+        std::begin(PROFILE_KEYS),
+        std::end(PROFILE_KEYS),
+        [&line](const auto& entry) {
+          const auto prefix = std::string(entry.first) + " = ";
+          return line.compare(0, prefix.size(), prefix) == 0;
+        }
+    );
+    if (!isProfile) {
+      contents += line + "\n";
+    }
+  }
+  for (const auto& [key, field] : PROFILE_KEYS) {
+    contents += std::string(key) + " = " + std::to_string(profile.*field)
+        + "\n";
   }
 
+  /// written aside and renamed over the configuration, which a watching
+  /// upload may read again at any time; it holds the secret key, so it
+  /// keeps its permissions
+  auto temporary = configFile_;
+  temporary += ".tmp";
+  {
+    std::ofstream stream(temporary);
+    stream << contents;
+    if (!stream.flush()) {
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::permissions(
+      temporary, std::filesystem::status(configFile_).permissions(), error
+  );
+  if (!error) {
+    std::filesystem::rename(temporary, configFile_, error);
+  }
+  if (error) {
+    std::filesystem::remove(temporary, error);
+    return false;
+  }
   return true;
 }
 
+std::string Cloud::readIniLine(
+    const std::string& config,
+    const std::string& key
+) {
+  /// only a line starting with the key counts, not one that contains it
+  /// (a bucket named after another key)
+  const std::string pattern = key + " = ";
+  std::size_t begin = 0;
+  if (config.compare(0, pattern.size(), pattern) != 0) {
+    begin = config.find("\n" + pattern);
+    if (begin == std::string::npos) {
+      return std::string();
+    }
+    begin++;
+  }
+  const auto value = begin + pattern.size();
+  const auto end = config.find('\n', value);
+  return config.substr(
+      value, end == std::string::npos ? std::string::npos : end - value
+  );
+}
+
 std::string Cloud::read(const std::filesystem::path& path) const {
   std::ifstream stream(path);
   std::stringstream ss;
@@ -684,6 +4114,156 @@ std::string urlEncode(const std::string& value) {
     return escaped.str();
 }
 
+std::string htmlEscape(const std::string& value) {
+  std::string ret;
+  for (const auto c : value) {
+    switch (c) {
+    case '&':
+      ret += "&amp;";
+      break;
+    case '<':
+      ret += "&lt;";
+      break;
+    case '>':
+      ret += "&gt;";
+      break;
+    case '"':
+      ret += "&quot;";
+      break;
+    default:
+      ret += c;
+    }
+  }
+  return ret;
+}
+
+std::string minifyHtml(const std::string& value) {
+  std::string ret;
+  ret.reserve(value.size());
+  for (std::size_t begin = 0; begin < value.size();) {
+    auto end = value.find('\n', begin);
+    if (end == std::string::npos) {
+      end = value.size();
+    }
+    const auto first = value.find_first_not_of(" \t\r", begin);
+    if (first != std::string::npos && first < end) {
+      const auto last = value.find_last_not_of(" \t\r", end - 1);
+      ret.append(value, first, last + 1 - first);
+      ret += '\n';
+    }
+    begin = end + 1;
+  }
+  return ret;
+}
+
+bool readAll(
+    int fd,
+    unsigned char* buffer,
+    std::size_t size,
+    std::size_t offset
+) {
+  while (size > 0) {
+    const auto got = ::pread(fd, buffer, size, offset);
+    if (got <= 0) {
+      return false;
+    }
+    buffer += got;
+    offset += got;
+    size -= got;
+  }
+  return true;
+}
+
+bool writeAll(
+    int fd,
+    const unsigned char* buffer,
+    std::size_t size,
+    std::size_t offset
+) {
+  while (size > 0) {
+    const auto written = ::pwrite(fd, buffer, size, offset);
+    if (written <= 0) {
+      return false;
+    }
+    buffer += written;
+    offset += written;
+    size -= written;
+  }
+  return true;
+}
+
+md5::Digest digest(const mapped::File& file) {
+  constexpr std::size_t chunk = 8 * 1024 * 1024;
+  md5::Md5 hash;
+  for (std::size_t offset = 0; offset < file.size(); offset += chunk) {
+    const auto length = std::min(chunk, file.size() - offset);
+    hash.update(file.data() + offset, length);
+    file.release(offset, length);
+  }
+  return hash.digest();
+}
+
+std::string multipartEtag(const mapped::File& file, std::size_t partSize) {
+  const auto parts = std::max<std::size_t>(
+      (file.size() + partSize - 1) / partSize, 1
+  );
+  std::string digests;
+
+  /// all parts but the last have the same size and are hashed 'LANES' at a
+  /// time
+  std::size_t part = 0;
+  for (; part + md5::LANES < parts; part += md5::LANES) {
+    const unsigned char* data[md5::LANES];
+    for (auto l = 0u; l < md5::LANES; l++) {
+      data[l] = file.data() + (part + l) * partSize;
+    }
+    for (const auto& digest : md5::digests(data, partSize)) {
+      digests.append(digest.begin(), digest.end());
+    }
+    file.release(part * partSize, md5::LANES * partSize);
+  }
+  for (; part < parts; part++) {
+    const auto offset = part * partSize;
+    const auto length = std::min(partSize, file.size() - offset);
+    const auto digest = md5::digest(file.data() + offset, length);
+    digests.append(digest.begin(), digest.end());
+    file.release(offset, length);
+  }
+
+  return md5::hex(md5::digest(digests.data(), digests.size()))
+      + "-" + std::to_string(parts);
+}
+
+std::optional<std::size_t> parseSize(const std::string& value) {
+  if (value.empty()) {
+    return {};
+  }
+  std::size_t consumed = 0;
+  unsigned long long number = 0;
+  try {
+    number = std::stoull(value, &consumed);
+  } catch (const std::exception&) {
+    return {};
+  }
+  const auto suffix = value.substr(consumed);
+  if (suffix.empty()) {
+    return number;
+  }
+  if (suffix.size() != 1) {
+    return {};
+  }
+  switch (std::toupper(static_cast<unsigned char>(suffix.front()))) {
+  case 'K':
+    return number << 10;
+  case 'M':
+    return number << 20;
+  case 'G':
+    return number << 30;
+  default:
+    return {};
+  }
+}
+
 } /// namespace util
 
 #endif /// CLOUD_CLOUD_HH_
@@ -0,0 +1,152 @@
+#ifndef CLOUDPHOTO_CLOUDPHOTO_H_
+#define CLOUDPHOTO_CLOUDPHOTO_H_
+
+/* C interface of libcloudphoto, a thin layer over cloudphoto::Client.
+ * Functions returning int give 0 on success and -1 on failure, strings
+ * passed to callbacks live until the callback returns. */
+
+#include <stddef.h>
+
+#define CLOUDPHOTO_VERSION_MAJOR 1
+#define CLOUDPHOTO_VERSION_MINOR 5
+
+#define CLOUDPHOTO_MAX_SHARDS 256
+
+#define CLOUDPHOTO_UPLOAD 0
+#define CLOUDPHOTO_DOWNLOAD 1
+
+#define CLOUDPHOTO_DURABILITY_NONE 0
+#define CLOUDPHOTO_DURABILITY_FILE 1
+#define CLOUDPHOTO_DURABILITY_BATCH 2
+
+#define CLOUDPHOTO_STRIP_NONE 0
+#define CLOUDPHOTO_STRIP_THUMBNAIL 1
+#define CLOUDPHOTO_STRIP_ALL 2
+
+#define CLOUDPHOTO_MISSING 0
+#define CLOUDPHOTO_EXTRA 1
+#define CLOUDPHOTO_MISMATCHED 2
+#define CLOUDPHOTO_UNVERIFIABLE 3
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cloudphoto_client cloudphoto_client;
+
+typedef void (*cloudphoto_progress)(const char* key, size_t bytes, void* user);
+typedef void (*cloudphoto_name)(const char* name, void* user);
+/* 'kind' is one of CLOUDPHOTO_MISSING, _EXTRA, _MISMATCHED or
+   _UNVERIFIABLE */
+typedef void (*cloudphoto_difference)(int kind, const char* name, void* user);
+
+typedef struct cloudphoto_job {
+  int kind; /* CLOUDPHOTO_UPLOAD or CLOUDPHOTO_DOWNLOAD */
+  const char* album;
+  const char* dir;
+  int packed;
+  int durability;
+} cloudphoto_job;
+
+typedef struct cloudphoto_result {
+  int ok;
+  size_t bytes;
+  long long elapsed_ms;
+} cloudphoto_result;
+
+/* major version of the library the caller runs with */
+int cloudphoto_version(void);
+
+/* opens a client configured by 'config', the user's cloudphotorc if NULL;
+ * 'max_memory' bytes of transfer buffers, the configured amount if 0;
+ * NULL on failure */
+cloudphoto_client* cloudphoto_open(const char* config, size_t max_memory);
+void cloudphoto_close(cloudphoto_client* client);
+
+/* bytes per second, 0 is unlimited */
+int cloudphoto_set_limit_rate(
+    cloudphoto_client* client,
+    size_t up,
+    size_t down
+);
+/* 'progress' is called from the transfer threads */
+int cloudphoto_set_progress(
+    cloudphoto_client* client,
+    cloudphoto_progress progress,
+    void* user
+);
+/* uploads re-encode photos losslessly, dropping 'strip' metadata */
+int cloudphoto_set_optimize(
+    cloudphoto_client* client,
+    int optimize,
+    int strip
+);
+/* albums created by an upload spread their photos over 'count' shards, at
+   most CLOUDPHOTO_MAX_SHARDS */
+int cloudphoto_set_shards(cloudphoto_client* client, size_t count);
+
+int cloudphoto_upload(
+    cloudphoto_client* client,
+    const char* album,
+    const char* dir,
+    int packed
+);
+int cloudphoto_download(
+    cloudphoto_client* client,
+    const char* album,
+    const char* dir,
+    int durability
+);
+/* runs 'count' jobs one after another and fills one result per job,
+ * returns the number of failed jobs */
+int cloudphoto_run(
+    cloudphoto_client* client,
+    const cloudphoto_job* jobs,
+    size_t count,
+    cloudphoto_result* results
+);
+
+int cloudphoto_albums(
+    cloudphoto_client* client,
+    cloudphoto_name each,
+    void* user
+);
+int cloudphoto_photos(
+    cloudphoto_client* client,
+    const char* album,
+    cloudphoto_name each,
+    void* user
+);
+/* deletes the whole album if 'photo' is NULL */
+int cloudphoto_delete(
+    cloudphoto_client* client,
+    const char* album,
+    const char* photo
+);
+int cloudphoto_copy(
+    cloudphoto_client* client,
+    const char* album,
+    const char* to
+);
+int cloudphoto_move(
+    cloudphoto_client* client,
+    const char* album,
+    const char* to
+);
+/* returns 1 if the directory and the album differ */
+int cloudphoto_verify(
+    cloudphoto_client* client,
+    const char* album,
+    const char* dir,
+    cloudphoto_difference each,
+    void* user
+);
+/* saves the fastest transfer profile to the configuration file, clients
+   opened afterwards use it */
+int cloudphoto_calibrate(cloudphoto_client* client);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* CLOUDPHOTO_CLOUDPHOTO_H_ */
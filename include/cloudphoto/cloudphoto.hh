@@ -0,0 +1,200 @@
+#ifndef CLOUDPHOTO_CLOUDPHOTO_HH_
+#define CLOUDPHOTO_CLOUDPHOTO_HH_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! Stable interface of libcloudphoto. Only standard library types cross it,
+//! the implementation (and the SDK) stays inside the library, so this
+//! header may be included by any number of translation units.
+
+namespace cloudphoto {
+
+constexpr int VERSION_MAJOR = 1;
+constexpr int VERSION_MINOR = 5;
+
+//! most key prefixes 'setShards' spreads an album over
+constexpr std::size_t MAX_SHARDS = 256;
+
+//! how downloaded photos reach stable storage
+enum class Durability {
+  NONE, /// left to the kernel
+  FILE, /// every photo is fsynced
+  BATCH, /// one sync of the file system at the end
+};
+
+//! metadata dropped from optimized photos
+enum class Strip {
+  NONE,
+  THUMBNAIL, /// the EXIF thumbnail
+  ALL, /// everything but the ICC colour profile
+};
+
+//! photo of an album with the metadata recorded at upload, empty (zero)
+//! fields are unknown
+struct Photo {
+  std::string name;
+  std::string date; /// ISO 8601
+  std::string camera;
+  std::uint16_t width = 0;
+  std::uint16_t height = 0;
+};
+
+//! result of comparing a local directory with an album
+struct Report {
+  std::vector<std::string> missing; /// local photos absent from the album
+  std::vector<std::string> extra; /// album photos absent locally
+  std::vector<std::string> mismatched; /// photos whose content differs
+  std::vector<std::string> unverifiable; /// photos with a malformed ETag
+};
+
+//! one transfer of a batch
+struct Job {
+  enum class Kind {
+    UPLOAD,
+    DOWNLOAD,
+  };
+  Kind kind = Kind::UPLOAD;
+  std::string album;
+  std::filesystem::path dir;
+  bool packed = false; /// uploads only
+  Durability durability = Durability::NONE; /// downloads only
+};
+
+//! outcome of one job of a batch
+struct Result {
+  bool ok = false;
+  std::size_t bytes = 0; /// bodies sent or received
+  std::chrono::milliseconds elapsed{0};
+};
+
+//! transfer parameters of the configured endpoint, as measured by
+//! 'Client::calibrate'
+struct Profile {
+  std::size_t partSize = 0;
+  std::size_t concurrency = 0; /// 0 is as many as the memory allows
+  std::size_t maxConnections = 0;
+  std::chrono::milliseconds requestTimeout{0};
+  std::chrono::milliseconds connectTimeout{0};
+  std::chrono::milliseconds tcpKeepAlive{0}; /// 0 is disabled
+};
+
+//! told the key and size of every body sent or received, from the transfer
+//! threads
+using Progress = std::function<void(
+    const std::string& key,
+    std::size_t bytes
+)>;
+
+//! Connection to one bucket. 'init' reads the configuration, starts the SDK
+//! and allocates the transfer buffers once, every call after it reuses
+//! them, so a long running caller pays for none of it per request. A
+//! client destroyed while initialised calls 'deinit' itself.
+class Client {
+public:
+  //! client configured by the user's cloudphotorc
+  Client();
+  explicit Client(const std::filesystem::path& configFile);
+  Client(Client&& other) noexcept;
+  Client& operator=(Client&& other) noexcept;
+  ~Client();
+  //! the setters take effect at 'init', the rate limits at any time
+  void setMaxMemory(std::size_t bytes);
+  void setLimitRate(std::size_t up, std::size_t down);
+  //! must not be changed while transfers are running
+  void setProgress(Progress progress);
+  //! uploads re-encode photos losslessly first when that makes them
+  //! smaller; packed and tar uploads are not optimized
+  void setOptimize(bool optimize, Strip strip = Strip::NONE);
+  //! albums created by an upload spread their photos over 'count' (at
+  //! most 'MAX_SHARDS') key prefixes, for request rates one prefix can not
+  //! take; existing albums keep their layout
+  void setShards(std::size_t count);
+  bool configure(
+      const std::string& keyId,
+      const std::string& key,
+      const std::string& bucket
+  );
+  bool init();
+  bool deinit();
+
+  bool upload(
+      const std::string& album,
+      const std::filesystem::path& dir,
+      bool packed = false
+  ) const;
+  //! uploads 'dir', then every photo arriving in it, until SIGINT or SIGTERM
+  bool watch(
+      const std::string& album,
+      const std::filesystem::path& dir,
+      bool packed = false
+  ) const;
+  //! uploads the photos of the tar archive read from 'fd'
+  bool uploadTar(const std::string& album, int fd) const;
+  bool download(
+      const std::string& album,
+      const std::filesystem::path& dir,
+      Durability durability = Durability::NONE
+  ) const;
+  //! runs 'jobs' one after another, each with all transfer threads
+  std::vector<Result> run(const std::vector<Job>& jobs) const;
+
+  //! calls 'each' with every album in name order
+  bool albums(const std::function<void(std::string_view)>& each) const;
+  //! calls 'each' with every photo of 'album' in name order, with the
+  //! recorded metadata if 'details'
+  bool photos(
+      const std::string& album,
+      const std::function<void(const Photo&)>& each,
+      bool details = false
+  ) const;
+  bool backfill(const std::string& album) const;
+  bool del(const std::string& album) const;
+  bool del(const std::string& album, const std::string& photo) const;
+  bool copy(const std::string& album, const std::string& to) const;
+  bool move(const std::string& album, const std::string& to) const;
+  bool unpack(const std::string& album) const;
+  std::optional<Report> verify(
+      const std::string& album,
+      const std::filesystem::path& dir
+  ) const;
+  //! 'album' empty mirrors the whole bucket
+  bool mirror(const std::string& album, const Client& destination) const;
+  //! URL of the published site, empty on failure
+  std::string mksite() const;
+  //! 'vendor' serves the scripts and styles of the pages from the bucket
+  //! instead of their CDNs
+  std::string mksite(bool vendor) const;
+  //! fails for packed albums, which pages can not link, and tells them to
+  //! 'packed'; 'unpack' turns them into one object per photo
+  std::string mksite(bool vendor, std::vector<std::string>& packed) const;
+  //! times short transfers under a scratch prefix with a sweep of part
+  //! sizes, concurrency and connections, and saves the fastest profile
+  //! (with timeouts fitted to it) to the configuration file, which every
+  //! later 'init' applies
+  std::optional<Profile> calibrate() const;
+protected:
+  class Impl;
+
+  std::unique_ptr<Impl> impl_;
+private:
+};
+
+//! parses sizes like "4096", "64K", "512M" or "4G"
+std::optional<std::size_t> parseSize(const std::string& value);
+//! parses "none" (or nothing), "file" and "batch"
+std::optional<Durability> parseDurability(const std::string& value);
+//! parses "none" (or nothing), "thumbnail" and "all"
+std::optional<Strip> parseStrip(const std::string& value);
+
+} /// namespace cloudphoto
+
+#endif /// CLOUDPHOTO_CLOUDPHOTO_HH_
@@ -0,0 +1,529 @@
+#ifndef EXIF_EXIF_HH_
+#define EXIF_EXIF_HH_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace exif {
+
+//! what the JPEG headers tell about a photo, empty fields are unknown
+struct Info {
+  std::string date; /// capture time as "YYYY:MM:DD HH:MM:SS"
+  std::string camera;
+  std::uint16_t width = 0;
+  std::uint16_t height = 0;
+};
+
+//! bytes the APP1/EXIF and SOF headers of a photo usually fit in
+constexpr std::size_t HEADER_SIZE = 64 * 1024;
+//! headers are not looked for past this many bytes
+constexpr std::size_t MAX_HEADER_SIZE = 1024 * 1024;
+
+//! parses the headers of a JPEG starting at 'data', stops at the first SOF.
+//! If 'size' bytes are not enough, returns nothing and sets 'need' to the
+//! number of bytes that are (0 if this is not a JPEG at all)
+std::optional<Info> parse(
+    const unsigned char* data,
+    std::size_t size,
+    std::size_t* need = nullptr
+);
+
+//! reads 'length' bytes of the photo starting at 'offset' into 'buffer'
+using Reader = std::function<bool(
+    unsigned char* buffer,
+    std::size_t offset,
+    std::size_t length
+)>;
+
+//! parses the headers of a photo of 'size' bytes reading only as many of
+//! its first bytes as the headers take, an empty info if there are none
+std::optional<Info> scan(std::size_t size, const Reader& read);
+
+//! "YYYY-MM-DD HH:MM:SS" out of the EXIF date format
+std::string isoDate(const std::string& date);
+
+//! unlinks the thumbnail (IFD1) from the APP1 segment payload 'data' in
+//! place, returns the new payload size, which is smaller if the thumbnail
+//! was stored last (as cameras do)
+std::size_t stripThumbnail(unsigned char* data, std::size_t size);
+
+//! one photo of the album metadata index
+struct Entry {
+  std::string name;
+  Info info;
+};
+
+//! Metadata index object of an album, entries are sorted by name.
+//!
+//! Layout (little endian):
+//!   "CPMD" u8:version u32:entries
+//!   entries * (u16:nameLength name u16:width u16:height
+//!              u8:dateLength date u8:cameraLength camera)
+class Index {
+public:
+  using value_type = std::vector<Entry>;
+  const value_type& entries() const;
+  const Info* find(std::string_view name) const;
+  //! adds 'entries', replacing photos of the same name
+  void merge(value_type entries);
+  bool remove(std::string_view name);
+  std::string serialize() const;
+  static std::optional<Index> parse(std::string_view data);
+protected:
+  value_type entries_;
+
+  static constexpr std::string_view MAGIC = "CPMD";
+  static constexpr std::uint8_t VERSION = 1;
+private:
+};
+
+} /// namespace exif
+
+/// implementation
+
+namespace exif {
+
+namespace {
+
+/// TIFF field types and tags used here
+constexpr std::uint16_t ASCII = 2;
+constexpr std::uint16_t MAKE = 0x010f;
+constexpr std::uint16_t MODEL = 0x0110;
+constexpr std::uint16_t DATE_TIME = 0x0132;
+constexpr std::uint16_t EXIF_IFD = 0x8769;
+constexpr std::uint16_t DATE_TIME_ORIGINAL = 0x9003;
+constexpr std::uint16_t THUMBNAIL_OFFSET = 0x0201;
+constexpr std::uint16_t THUMBNAIL_LENGTH = 0x0202;
+
+constexpr std::string_view SIGNATURE("Exif\0\0", 6);
+
+/// bounds checked view of the TIFF structure inside an APP1 segment
+class Tiff {
+public:
+  Tiff(const unsigned char* data, std::size_t size)
+      : data_(data), size_(size) {}
+
+  bool header(std::uint32_t& ifd) {
+    if (size_ < 8) {
+      return false;
+    }
+    if (data_[0] == 'I' && data_[1] == 'I') {
+      little_ = true;
+    } else if (data_[0] != 'M' || data_[1] != 'M') {
+      return false;
+    }
+    if (u16(2) != 42) {
+      return false;
+    }
+    ifd = u32(4);
+    return true;
+  }
+
+  //! calls 'visit(tag, type, count, valueOffset)' for every field of the
+  //! directory at 'offset'
+  template <typename Visit>
+  void ifd(std::uint32_t offset, Visit&& visit) const {
+    if (offset > size_ || size_ - offset < 2) {
+      return;
+    }
+    const auto count = u16(offset);
+    for (auto i = 0u; i < count; i++) {
+      const std::size_t entry = offset + 2 + 12 * i;
+      if (entry + 12 > size_) {
+        return;
+      }
+      visit(u16(entry), u16(entry + 2), u32(entry + 4), entry + 8);
+    }
+  }
+
+  std::string ascii(std::uint32_t count, std::size_t valueOffset) const {
+    const std::size_t offset = count <= 4 ? valueOffset : u32(valueOffset);
+    if (offset > size_ || count > size_ - offset) {
+      return std::string();
+    }
+    std::string ret;
+    for (auto i = 0u; i < count && data_[offset + i] != '\0'; i++) {
+      const auto c = static_cast<char>(data_[offset + i]);
+      ret += (c >= ' ' && c <= '~') ? c : ' ';
+    }
+    while (!ret.empty() && ret.back() == ' ') {
+      ret.pop_back();
+    }
+    return ret;
+  }
+
+  std::uint32_t u32(std::size_t offset) const {
+    std::uint32_t ret = 0;
+    for (auto i = 0u; i < 4; i++) {
+      const auto byte = data_[offset + (little_ ? 3 - i : i)];
+      ret = (ret << 8) | byte;
+    }
+    return ret;
+  }
+
+  std::uint16_t u16(std::size_t offset) const {
+    return little_
+        ? static_cast<std::uint16_t>(data_[offset] | (data_[offset + 1] << 8))
+        : static_cast<std::uint16_t>((data_[offset] << 8) | data_[offset + 1]);
+  }
+protected:
+  const unsigned char* data_;
+  std::size_t size_;
+  bool little_ = false;
+};
+
+void app1(const unsigned char* data, std::size_t size, Info& info) {
+  if (
+      size < SIGNATURE.size()
+      || std::string_view(reinterpret_cast<const char*>(data), 6) != SIGNATURE
+  ) {
+    return;
+  }
+  Tiff tiff(data + SIGNATURE.size(), size - SIGNATURE.size());
+  std::uint32_t first = 0;
+  if (!tiff.header(first)) {
+    return;
+  }
+
+  std::string make;
+  std::string model;
+  std::uint32_t exif = 0;
+  tiff.ifd(first, [&](auto tag, auto type, auto count, auto value) {
+    if (tag == EXIF_IFD) {
+      exif = tiff.u32(value);
+    } else if (type != ASCII) {
+      return;
+    } else if (tag == MAKE) {
+      make = tiff.ascii(count, value);
+    } else if (tag == MODEL) {
+      model = tiff.ascii(count, value);
+    } else if (tag == DATE_TIME) {
+      info.date = tiff.ascii(count, value);
+    }
+  });
+  if (exif != 0) {
+    tiff.ifd(exif, [&](auto tag, auto type, auto count, auto value) {
+      if (tag == DATE_TIME_ORIGINAL && type == ASCII) {
+        const auto date = tiff.ascii(count, value);
+        if (!date.empty()) {
+          info.date = date;
+        }
+      }
+    });
+  }
+  /// models usually repeat the make already ("Canon EOS 5D")
+  info.camera = model.compare(0, make.size(), make) == 0 || make.empty()
+      ? model
+      : model.empty() ? make : make + " " + model;
+}
+
+bool isSof(unsigned char marker) {
+  return marker >= 0xc0 && marker <= 0xcf
+      && marker != 0xc4 && marker != 0xc8 && marker != 0xcc;
+}
+
+template <typename T>
+void write(std::string& out, T value) {
+  for (auto i = 0u; i < sizeof(T); i++) {
+    out += static_cast<char>(
+        (static_cast<std::uint64_t>(value) >> (8 * i)) & 0xff
+    );
+  }
+}
+
+template <typename T>
+bool read(std::string_view& in, T& value) {
+  if (in.size() < sizeof(T)) {
+    return false;
+  }
+  std::uint64_t ret = 0;
+  for (auto i = 0u; i < sizeof(T); i++) {
+    ret |= static_cast<std::uint64_t>(
+        static_cast<unsigned char>(in[i])
+    ) << (8 * i);
+  }
+  value = static_cast<T>(ret);
+  in.remove_prefix(sizeof(T));
+  return true;
+}
+
+bool read(std::string_view& in, std::size_t length, std::string& value) {
+  if (in.size() < length) {
+    return false;
+  }
+  value = std::string(in.substr(0, length));
+  in.remove_prefix(length);
+  return true;
+}
+
+} /// namespace
+
+std::optional<Info> parse(
+    const unsigned char* data,
+    std::size_t size,
+    std::size_t* need
+) {
+  const auto fail = [need](std::size_t bytes) {
+    if (need != nullptr) {
+      *need = bytes;
+    }
+    return std::optional<Info>();
+  };
+  if (size < 2) {
+    return fail(2);
+  }
+  if (data[0] != 0xff || data[1] != 0xd8) {
+    return fail(0);
+  }
+
+  Info info;
+  std::size_t pos = 2;
+  while (true) {
+    /// a marker may be preceded by any number of 0xff fill bytes
+    while (pos + 1 < size && data[pos] == 0xff && data[pos + 1] == 0xff) {
+      pos++;
+    }
+    if (pos + 4 > size) {
+      return fail(pos + 4);
+    }
+    if (data[pos] != 0xff) {
+      return fail(0);
+    }
+    const auto marker = data[pos + 1];
+    /// markers without a length
+    if (
+        marker == 0xd8 || marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)
+    ) {
+      pos += 2;
+      continue;
+    }
+    /// the image data starts without a frame header, nothing more to find
+    if (marker == 0xda || marker == 0xd9) {
+      return fail(0);
+    }
+    const std::size_t length = (data[pos + 2] << 8) | data[pos + 3];
+    if (length < 2) {
+      return fail(0);
+    }
+    const auto end = pos + 2 + length;
+    if (marker == 0xe1 || isSof(marker)) {
+      if (end > size) {
+        return fail(end);
+      }
+      if (marker == 0xe1) {
+        app1(data + pos + 4, length - 2, info);
+      } else if (length >= 7) {
+        info.height = static_cast<std::uint16_t>(
+            (data[pos + 5] << 8) | data[pos + 6]
+        );
+        info.width = static_cast<std::uint16_t>(
+            (data[pos + 7] << 8) | data[pos + 8]
+        );
+        return info;
+      }
+    }
+    pos = end;
+  }
+}
+
+std::optional<Info> scan(std::size_t size, const Reader& read) {
+  std::vector<unsigned char> buffer;
+  std::size_t need = std::min(size, HEADER_SIZE);
+  while (need > buffer.size()) {
+    const auto have = buffer.size();
+    buffer.resize(need);
+    if (!read(buffer.data() + have, have, need - have)) {
+      return {};
+    }
+    const auto info = parse(buffer.data(), buffer.size(), &need);
+    if (info.has_value()) {
+      return info;
+    }
+    /// the next header ends past the photo or too far into it, give up
+    if (need > size || need > MAX_HEADER_SIZE) {
+      break;
+    }
+    /// reads a few more headers at once than the next one takes
+    need = std::min(
+        {size, MAX_HEADER_SIZE, std::max(need, have + HEADER_SIZE)}
+    );
+  }
+  return Info();
+}
+
+std::size_t stripThumbnail(unsigned char* data, std::size_t size) {
+  if (
+      size < SIGNATURE.size()
+      || std::string_view(reinterpret_cast<const char*>(data), 6) != SIGNATURE
+  ) {
+    return size;
+  }
+  auto* tiffData = data + SIGNATURE.size();
+  const auto tiffSize = size - SIGNATURE.size();
+  Tiff tiff(tiffData, tiffSize);
+  std::uint32_t first = 0;
+  if (!tiff.header(first) || first > tiffSize || tiffSize - first < 2) {
+    return size;
+  }
+  /// IFD0 is followed by the offset of the next directory, the thumbnail's
+  const std::size_t next = first + 2 + 12 * std::size_t(tiff.u16(first));
+  if (next + 4 > tiffSize || tiff.u32(next) == 0) {
+    return size;
+  }
+  std::uint32_t offset = 0;
+  std::uint32_t length = 0;
+  tiff.ifd(tiff.u32(next), [&](auto tag, auto, auto, auto value) {
+    if (tag == THUMBNAIL_OFFSET) {
+      offset = tiff.u32(value);
+    } else if (tag == THUMBNAIL_LENGTH) {
+      length = tiff.u32(value);
+    }
+  });
+  std::fill(tiffData + next, tiffData + next + 4, 0);
+  if (offset != 0 && offset < tiffSize && length == tiffSize - offset) {
+    return SIGNATURE.size() + offset;
+  }
+  return size;
+}
+
+std::string isoDate(const std::string& date) {
+  auto ret = date;
+  for (auto i : {4u, 7u}) {
+    if (i < ret.size() && ret[i] == ':') {
+      ret[i] = '-';
+    }
+  }
+  return ret;
+}
+
+const Index::value_type& Index::entries() const { return entries_; }
+
+const Info* Index::find(std::string_view name) const {
+  const auto it = std::lower_bound(
+      entries_.begin(),
+      entries_.end(),
+      name,
+      [](const Entry& entry, std::string_view name) {
+        return entry.name < name;
+      }
+  );
+  return it != entries_.end() && it->name == name ? &it->info : nullptr;
+}
+
+void Index::merge(value_type entries) {
+  const auto byName = [](const Entry& lhs, const Entry& rhs) {
+    return lhs.name < rhs.name;
+  };
+  std::stable_sort(entries.begin(), entries.end(), byName);
+  /// the last of equally named new entries wins
+  value_type added;
+  for (auto& entry : entries) {
+    if (!added.empty() && added.back().name == entry.name) {
+      added.back() = std::move(entry);
+    } else {
+      added.push_back(std::move(entry));
+    }
+  }
+
+  value_type merged;
+  merged.reserve(entries_.size() + added.size());
+  auto old = entries_.begin();
+  for (auto& entry : added) {
+    for (; old != entries_.end() && old->name < entry.name; old++) {
+      merged.push_back(std::move(*old));
+    }
+    if (old != entries_.end() && old->name == entry.name) {
+      old++;
+    }
+    merged.push_back(std::move(entry));
+  }
+  std::move(old, entries_.end(), std::back_inserter(merged));
+  entries_ = std::move(merged);
+}
+
+bool Index::remove(std::string_view name) {
+  const auto it = std::lower_bound(
+      entries_.begin(),
+      entries_.end(),
+      name,
+      [](const Entry& entry, std::string_view name) {
+        return entry.name < name;
+      }
+  );
+  if (it == entries_.end() || it->name != name) {
+    return false;
+  }
+  entries_.erase(it);
+  return true;
+}
+
+std::string Index::serialize() const {
+  std::string ret(MAGIC);
+  write(ret, VERSION);
+  write(ret, static_cast<std::uint32_t>(entries_.size()));
+  for (const auto& entry : entries_) {
+    const auto date = entry.info.date.substr(0, 0xff);
+    const auto camera = entry.info.camera.substr(0, 0xff);
+    write(ret, static_cast<std::uint16_t>(entry.name.size()));
+    ret += entry.name;
+    write(ret, entry.info.width);
+    write(ret, entry.info.height);
+    write(ret, static_cast<std::uint8_t>(date.size()));
+    ret += date;
+    write(ret, static_cast<std::uint8_t>(camera.size()));
+    ret += camera;
+  }
+  return ret;
+}
+
+std::optional<Index> Index::parse(std::string_view data) {
+  if (data.substr(0, MAGIC.size()) != MAGIC) {
+    return {};
+  }
+  data.remove_prefix(MAGIC.size());
+
+  Index ret;
+  std::uint8_t version = 0;
+  std::uint32_t count = 0;
+  if (!read(data, version) || version != VERSION || !read(data, count)) {
+    return {};
+  }
+  for (auto i = 0u; i < count; i++) {
+    Entry entry;
+    std::uint16_t nameLength = 0;
+    std::uint8_t dateLength = 0;
+    std::uint8_t cameraLength = 0;
+    if (
+        !read(data, nameLength)
+        || !read(data, nameLength, entry.name)
+        || !read(data, entry.info.width)
+        || !read(data, entry.info.height)
+        || !read(data, dateLength)
+        || !read(data, dateLength, entry.info.date)
+        || !read(data, cameraLength)
+        || !read(data, cameraLength, entry.info.camera)
+    ) {
+      return {};
+    }
+    ret.entries_.push_back(std::move(entry));
+  }
+  /// written sorted, but the order is what 'find' relies on
+  if (!std::is_sorted(
+      ret.entries_.begin(),
+      ret.entries_.end(),
+      [](const Entry& lhs, const Entry& rhs) { return lhs.name < rhs.name; }
+  )) {
+    return {};
+  }
+  return ret;
+}
+
+} /// namespace exif
+
+#endif /// EXIF_EXIF_HH_
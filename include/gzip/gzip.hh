@@ -0,0 +1,50 @@
+#ifndef GZIP_GZIP_HH_
+#define GZIP_GZIP_HH_
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <zlib.h>
+
+namespace gzip {
+
+//! gzip member of 'data', the same bytes for the same input (no file name,
+//! no modification time) so stored ETags only change with the content
+std::optional<std::string> compress(std::string_view data, int level = 9);
+
+} /// namespace gzip
+
+/// implementation
+
+namespace gzip {
+
+std::optional<std::string> compress(std::string_view data, int level) {
+  z_stream stream{};
+  /// 16 on top of the window bits asks for a gzip header and trailer
+  if (
+      deflateInit2(
+          &stream, level, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY
+      ) != Z_OK
+  ) {
+    return {};
+  }
+  std::string ret(deflateBound(&stream, data.size()), '\0');
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef*>(ret.data());
+  stream.avail_out = static_cast<uInt>(ret.size());
+  const auto status = deflate(&stream, Z_FINISH);
+  ret.resize(stream.total_out);
+  deflateEnd(&stream);
+  if (status != Z_STREAM_END) {
+    return {};
+  }
+  return ret;
+}
+
+} /// namespace gzip
+
+#endif /// GZIP_GZIP_HH_
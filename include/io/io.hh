@@ -0,0 +1,648 @@
+#ifndef IO_IO_HH_
+#define IO_IO_HH_
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace io {
+
+//! when written files are flushed to stable storage
+enum class Durability {
+  NONE, /// left to the kernel
+  FILE, /// every file is fsync'ed after it is written
+  BATCH, /// one file system sync after the whole transfer
+};
+
+std::optional<Durability> parseDurability(const std::string& value);
+
+//! Queue of file system operations. 'submit' hands the whole queue to the
+//! kernel through an io_uring in one system call per ring-full when the
+//! kernel supports it, otherwise runs it with plain pread/pwrite & co.
+class Ring {
+public:
+  Ring();
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+  ~Ring();
+  bool accelerated() const;
+  void statx(const std::filesystem::path& path, struct statx* out);
+  void openat(const std::filesystem::path& path, int flags, mode_t mode = 0);
+  void read(int fd, void* buffer, std::size_t size, std::uint64_t offset);
+  void write(
+      int fd,
+      const void* buffer,
+      std::size_t size,
+      std::uint64_t offset
+  );
+  void fsync(int fd);
+  void close(int fd);
+  //! runs every queued operation and returns the results in queue order, a
+  //! negative result is '-errno'
+  std::vector<int> submit();
+  //! ring of the calling thread
+  static Ring& local();
+protected:
+  enum class Kind { STATX, OPENAT, READ, WRITE, FSYNC, CLOSE };
+  struct Op {
+    Kind kind;
+    int fd = -1;
+    const char* path = nullptr;
+    void* buffer = nullptr;
+    std::size_t size = 0;
+    std::uint64_t offset = 0;
+    int flags = 0;
+    mode_t mode = 0;
+  };
+
+  bool setup();
+  //! unmaps and closes the ring, 'submit' runs everything itself afterwards
+  void shutdown();
+  int run(const Op& op) const;
+  bool enter(std::size_t first, std::size_t count, std::vector<int>& results);
+
+  std::vector<Op> queue_;
+  std::deque<std::string> paths_;
+
+  int fd_ = -1;
+  void* sqRing_ = nullptr;
+  std::size_t sqRingSize_ = 0;
+  void* cqRing_ = nullptr;
+  std::size_t cqRingSize_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  std::size_t sqesSize_ = 0;
+  unsigned* sqTail_ = nullptr;
+  unsigned* sqMask_ = nullptr;
+  unsigned* sqArray_ = nullptr;
+  unsigned sqEntries_ = 0;
+  unsigned* cqHead_ = nullptr;
+  unsigned* cqTail_ = nullptr;
+  unsigned* cqMask_ = nullptr;
+  io_uring_cqe* cqes_ = nullptr;
+
+  static constexpr unsigned ENTRIES = 64;
+  /// pause of a busy ring with nothing in flight to wait for
+  static constexpr std::chrono::microseconds BUSY_DELAY{50};
+private:
+};
+
+//! sizes of 'paths', stat'ed in one batch
+std::optional<std::vector<std::size_t>> sizes(
+    const std::vector<std::filesystem::path>& paths
+);
+
+//! reads whole files of known 'sizes' into 'buffers', opening, reading and
+//! closing all of them as one batch each
+bool readFiles(
+    const std::vector<std::filesystem::path>& paths,
+    const std::vector<std::size_t>& sizes,
+    const std::vector<unsigned char*>& buffers
+);
+
+//! creates or truncates 'paths' and writes 'data' into them in batches,
+//! fsync'ing each one if 'durability' is 'FILE'
+bool writeFiles(
+    const std::vector<std::filesystem::path>& paths,
+    const std::vector<const unsigned char*>& data,
+    const std::vector<std::size_t>& sizes,
+    Durability durability
+);
+
+//! flushes the file system holding 'dir' and the directory itself
+bool sync(const std::filesystem::path& dir);
+
+} /// namespace io
+
+/// implementation
+
+namespace io {
+
+std::optional<Durability> parseDurability(const std::string& value) {
+  if (value.empty() || value == "none") {
+    return Durability::NONE;
+  }
+  if (value == "file") {
+    return Durability::FILE;
+  }
+  if (value == "batch") {
+    return Durability::BATCH;
+  }
+  return {};
+}
+
+#ifdef __linux__
+Ring::Ring() {
+  if (!setup() && fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+Ring::~Ring() {
+  shutdown();
+}
+
+void Ring::shutdown() {
+  if (sqes_ != nullptr) {
+    ::munmap(sqes_, sqesSize_);
+    sqes_ = nullptr;
+  }
+  if (cqRing_ != nullptr && cqRing_ != sqRing_) {
+    ::munmap(cqRing_, cqRingSize_);
+  }
+  cqRing_ = nullptr;
+  if (sqRing_ != nullptr) {
+    ::munmap(sqRing_, sqRingSize_);
+    sqRing_ = nullptr;
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool Ring::accelerated() const { return fd_ >= 0; }
+
+bool Ring::setup() {
+  io_uring_params params {};
+  fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, ENTRIES, &params));
+  if (fd_ < 0) {
+    return false;
+  }
+
+  /// every operation used here has to be supported, older kernels fall back
+  /// as a whole
+  {
+    constexpr unsigned ops = 256;
+    std::vector<unsigned char> buffer(
+        sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op)
+    );
+    auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+    if (::syscall(
+        __NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, ops
+    ) < 0) {
+      return false;
+    }
+    for (const auto op : {
+        IORING_OP_STATX,
+        IORING_OP_OPENAT,
+        IORING_OP_READ,
+        IORING_OP_WRITE,
+        IORING_OP_FSYNC,
+        IORING_OP_CLOSE,
+    }) {
+      if (
+          op > probe->last_op
+          || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)
+      ) {
+        return false;
+      }
+    }
+  }
+
+  sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const auto single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single) {
+    sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+  }
+  sqRing_ = ::mmap(
+      nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING
+  );
+  if (sqRing_ == MAP_FAILED) {
+    sqRing_ = nullptr;
+    return false;
+  }
+  if (single) {
+    cqRing_ = sqRing_;
+  } else {
+    cqRing_ = ::mmap(
+        nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING
+    );
+    if (cqRing_ == MAP_FAILED) {
+      cqRing_ = nullptr;
+      return false;
+    }
+  }
+  sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = ::mmap(
+      nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES
+  );
+  if (sqes == MAP_FAILED) {
+    return false;
+  }
+  sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+  auto* sq = static_cast<unsigned char*>(sqRing_);
+  sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  sqEntries_ = params.sq_entries;
+  auto* cq = static_cast<unsigned char*>(cqRing_);
+  cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  return true;
+}
+
+void Ring::statx(const std::filesystem::path& path, struct statx* out) {
+  paths_.push_back(path.string());
+  Op op {Kind::STATX};
+  op.path = paths_.back().c_str();
+  op.buffer = out;
+  queue_.push_back(op);
+}
+
+void Ring::openat(const std::filesystem::path& path, int flags, mode_t mode) {
+  paths_.push_back(path.string());
+  Op op {Kind::OPENAT};
+  op.path = paths_.back().c_str();
+  op.flags = flags;
+  op.mode = mode;
+  queue_.push_back(op);
+}
+
+void Ring::read(int fd, void* buffer, std::size_t size, std::uint64_t offset) {
+  Op op {Kind::READ};
+  op.fd = fd;
+  op.buffer = buffer;
+  op.size = size;
+  op.offset = offset;
+  queue_.push_back(op);
+}
+
+void Ring::write(
+    int fd,
+    const void* buffer,
+    std::size_t size,
+    std::uint64_t offset
+) {
+  Op op {Kind::WRITE};
+  op.fd = fd;
+  op.buffer = const_cast<void*>(buffer);
+  op.size = size;
+  op.offset = offset;
+  queue_.push_back(op);
+}
+
+void Ring::fsync(int fd) {
+  Op op {Kind::FSYNC};
+  op.fd = fd;
+  queue_.push_back(op);
+}
+
+void Ring::close(int fd) {
+  Op op {Kind::CLOSE};
+  op.fd = fd;
+  queue_.push_back(op);
+}
+
+std::vector<int> Ring::submit() {
+  std::vector<int> results(queue_.size(), -EIO);
+  /// a ring shut down on the way leaves the rest of the queue to 'run'
+  for (std::size_t first = 0; first < queue_.size();) {
+    const auto count = std::min<std::size_t>(
+        accelerated() ? sqEntries_ : queue_.size(), queue_.size() - first
+    );
+    if (!accelerated() || !enter(first, count, results)) {
+      for (auto i = first; i < first + count; i++) {
+        results[i] = run(queue_[i]);
+      }
+    }
+    first += count;
+  }
+  queue_.clear();
+  paths_.clear();
+  return results;
+}
+
+Ring& Ring::local() {
+  thread_local Ring ring;
+  return ring;
+}
+
+int Ring::run(const Op& op) const {
+  long ret = -1;
+  switch (op.kind) {
+  case Kind::STATX:
+    ret = ::statx(
+        AT_FDCWD, op.path, 0, STATX_SIZE, static_cast<struct statx*>(op.buffer)
+    );
+    break;
+  case Kind::OPENAT:
+    ret = ::openat(AT_FDCWD, op.path, op.flags, op.mode);
+    break;
+  case Kind::READ:
+    ret = ::pread(op.fd, op.buffer, op.size, op.offset);
+    break;
+  case Kind::WRITE:
+    ret = ::pwrite(op.fd, op.buffer, op.size, op.offset);
+    break;
+  case Kind::FSYNC:
+    ret = ::fsync(op.fd);
+    break;
+  case Kind::CLOSE:
+    ret = ::close(op.fd);
+    break;
+  }
+  return ret < 0 ? -errno : static_cast<int>(ret);
+}
+
+bool Ring::enter(
+    std::size_t first,
+    std::size_t count,
+    std::vector<int>& results
+) {
+  const auto head = *sqTail_;
+  auto tail = head;
+  for (auto i = first; i < first + count; i++) {
+    const auto& op = queue_[i];
+    const auto index = tail & *sqMask_;
+    auto& sqe = sqes_[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.user_data = i;
+    sqe.fd = op.fd;
+    switch (op.kind) {
+    case Kind::STATX:
+      sqe.opcode = IORING_OP_STATX;
+      sqe.fd = AT_FDCWD;
+      sqe.addr = reinterpret_cast<std::uint64_t>(op.path);
+      sqe.len = STATX_SIZE;
+      sqe.off = reinterpret_cast<std::uint64_t>(op.buffer);
+      break;
+    case Kind::OPENAT:
+      sqe.opcode = IORING_OP_OPENAT;
+      sqe.fd = AT_FDCWD;
+      sqe.addr = reinterpret_cast<std::uint64_t>(op.path);
+      sqe.len = op.mode;
+      sqe.open_flags = static_cast<std::uint32_t>(op.flags);
+      break;
+    case Kind::READ:
+    case Kind::WRITE:
+      sqe.opcode = op.kind == Kind::READ ? IORING_OP_READ : IORING_OP_WRITE;
+      sqe.addr = reinterpret_cast<std::uint64_t>(op.buffer);
+      sqe.len = static_cast<std::uint32_t>(op.size);
+      sqe.off = op.offset;
+      break;
+    case Kind::FSYNC:
+      sqe.opcode = IORING_OP_FSYNC;
+      break;
+    case Kind::CLOSE:
+      sqe.opcode = IORING_OP_CLOSE;
+      break;
+    }
+    sqArray_[index] = index;
+    tail++;
+  }
+  __atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+
+  std::size_t submitted = 0;
+  std::size_t completed = 0;
+  const auto reap = [&]() {
+    auto head = *cqHead_;
+    const auto cqTail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != cqTail; head++) {
+      const auto& cqe = cqes_[head & *cqMask_];
+      results[cqe.user_data] = cqe.res;
+      completed++;
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+  };
+  while (completed < count) {
+    const auto ret = ::syscall(
+        __NR_io_uring_enter,
+        fd_,
+        static_cast<unsigned>(count - submitted),
+        static_cast<unsigned>(count - completed),
+        IORING_ENTER_GETEVENTS,
+        nullptr,
+        0
+    );
+    if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      if (submitted == 0) {
+        /// nothing reached the kernel, the caller runs the batch itself
+        __atomic_store_n(sqTail_, head, __ATOMIC_RELEASE);
+        return false;
+      }
+      /// the operations in flight write into the caller's buffers, none is
+      /// left behind for the next batch: each is waited for, and a ring
+      /// that can not even wait is shut down
+      __atomic_store_n(
+          sqTail_, head + static_cast<unsigned>(submitted), __ATOMIC_RELEASE
+      );
+      while (completed < submitted) {
+        const auto waited = ::syscall(
+            __NR_io_uring_enter,
+            fd_,
+            0u,
+            static_cast<unsigned>(submitted - completed),
+            IORING_ENTER_GETEVENTS,
+            nullptr,
+            0
+        );
+        if (
+            waited < 0
+            && errno != EINTR && errno != EAGAIN && errno != EBUSY
+        ) {
+          shutdown();
+          break;
+        }
+        reap();
+      }
+      /// the kernel takes entries in order, the ones it did not take run
+      /// here
+      for (auto i = first + submitted; i < first + count; i++) {
+        results[i] = run(queue_[i]);
+      }
+      return true;
+    }
+    if (ret > 0) {
+      submitted += static_cast<std::size_t>(ret);
+    }
+    if (ret < 0 && (errno == EAGAIN || errno == EBUSY)) {
+      /// the kernel takes nothing more until completions are reaped: wait
+      /// for one of the operations in flight instead of spinning
+      if (completed < submitted) {
+        ::syscall(
+            __NR_io_uring_enter,
+            fd_,
+            0u,
+            1u,
+            IORING_ENTER_GETEVENTS,
+            nullptr,
+            0
+        );
+      } else {
+        std::this_thread::sleep_for(BUSY_DELAY);
+      }
+    }
+    reap();
+  }
+  return true;
+}
+#else
+#error your OS is not supported
+#endif
+
+std::optional<std::vector<std::size_t>> sizes(
+    const std::vector<std::filesystem::path>& paths
+) {
+  auto& ring = Ring::local();
+  std::vector<struct statx> stats(paths.size());
+  for (auto i = 0u; i < paths.size(); i++) {
+    ring.statx(paths[i], &stats[i]);
+  }
+  const auto results = ring.submit();
+
+  std::vector<std::size_t> ret(paths.size());
+  for (auto i = 0u; i < paths.size(); i++) {
+    if (results[i] < 0) {
+      return {};
+    }
+    ret[i] = static_cast<std::size_t>(stats[i].stx_size);
+  }
+  return ret;
+}
+
+bool readFiles(
+    const std::vector<std::filesystem::path>& paths,
+    const std::vector<std::size_t>& sizes,
+    const std::vector<unsigned char*>& buffers
+) {
+  auto& ring = Ring::local();
+  for (const auto& path : paths) {
+    ring.openat(path, O_RDONLY | O_CLOEXEC);
+  }
+  const auto fds = ring.submit();
+
+  auto ok = true;
+  for (auto i = 0u; i < paths.size(); i++) {
+    if (fds[i] < 0) {
+      ok = false;
+    } else if (sizes[i] > 0) {
+      ring.read(fds[i], buffers[i], sizes[i], 0);
+    }
+  }
+  const auto reads = ok ? ring.submit() : std::vector<int>();
+
+  /// a short read is finished with plain pread
+  for (std::size_t i = 0, r = 0; ok && i < paths.size(); i++) {
+    if (sizes[i] == 0) {
+      continue;
+    }
+    auto done = static_cast<std::size_t>(std::max(reads[r++], 0));
+    while (done < sizes[i]) {
+      const auto got = ::pread(
+          fds[i], buffers[i] + done, sizes[i] - done, done
+      );
+      if (got <= 0) {
+        ok = false;
+        break;
+      }
+      done += static_cast<std::size_t>(got);
+    }
+  }
+
+  for (const auto fd : fds) {
+    if (fd >= 0) {
+      ring.close(fd);
+    }
+  }
+  ring.submit();
+  return ok;
+}
+
+bool writeFiles(
+    const std::vector<std::filesystem::path>& paths,
+    const std::vector<const unsigned char*>& data,
+    const std::vector<std::size_t>& sizes,
+    Durability durability
+) {
+  auto& ring = Ring::local();
+  for (const auto& path : paths) {
+    ring.openat(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  }
+  const auto fds = ring.submit();
+
+  auto ok = true;
+  for (auto i = 0u; i < paths.size(); i++) {
+    if (fds[i] < 0) {
+      ok = false;
+    } else if (sizes[i] > 0) {
+      ring.write(fds[i], data[i], sizes[i], 0);
+    }
+  }
+  const auto writes = ok ? ring.submit() : std::vector<int>();
+
+  /// a short write is finished with plain pwrite
+  for (std::size_t i = 0, w = 0; ok && i < paths.size(); i++) {
+    if (sizes[i] == 0) {
+      continue;
+    }
+    auto done = static_cast<std::size_t>(std::max(writes[w++], 0));
+    while (done < sizes[i]) {
+      const auto written = ::pwrite(
+          fds[i], data[i] + done, sizes[i] - done, done
+      );
+      if (written <= 0) {
+        ok = false;
+        break;
+      }
+      done += static_cast<std::size_t>(written);
+    }
+  }
+
+  if (ok && durability == Durability::FILE) {
+    for (const auto fd : fds) {
+      ring.fsync(fd);
+    }
+    for (const auto result : ring.submit()) {
+      ok = ok && result == 0;
+    }
+  }
+
+  for (const auto fd : fds) {
+    if (fd >= 0) {
+      ring.close(fd);
+    }
+  }
+  for (const auto result : ring.submit()) {
+    ok = ok && result == 0;
+  }
+  return ok;
+}
+
+bool sync(const std::filesystem::path& dir) {
+  const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  const auto ok = ::syncfs(fd) == 0 && ::fsync(fd) == 0;
+  return (::close(fd) == 0) && ok;
+}
+
+} /// namespace io
+
+#endif /// IO_IO_HH_
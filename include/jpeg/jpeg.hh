@@ -0,0 +1,177 @@
+#ifndef JPEG_JPEG_HH_
+#define JPEG_JPEG_HH_
+
+#include <exif/exif.hh>
+
+#include <csetjmp>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <jpeglib.h>
+
+namespace jpeg {
+
+//! metadata dropped from optimized photos
+enum class Strip {
+  NONE,
+  THUMBNAIL, /// the EXIF thumbnail
+  ALL, /// everything but the ICC colour profile
+};
+
+//! parses "none" (or nothing), "thumbnail" and "all"
+std::optional<Strip> parseStrip(const std::string& value);
+
+//! Re-encodes the JPEG of 'size' bytes at 'data' losslessly, as jpegtran
+//! does: the DCT coefficients are copied as they are, only the entropy
+//! coding is redone with Huffman tables optimized for this photo (in a
+//! progressive sequence if the photo was progressive). Returns
+//! nothing for anything libjpeg can not transcode without a warning.
+std::optional<std::string> optimize(
+    const unsigned char* data,
+    std::size_t size,
+    Strip strip
+);
+
+} /// namespace jpeg
+
+/// implementation
+
+namespace jpeg {
+
+namespace {
+
+/// everything libjpeg touches lives here, errors leave 'transcode' with a
+/// longjmp past its frame, which must hold no object with a destructor
+struct Session {
+  jpeg_error_mgr error; /// first, 'fail' casts it back to the session
+  std::jmp_buf jump;
+  jpeg_decompress_struct source;
+  jpeg_compress_struct target;
+  unsigned char* out;
+  unsigned long outSize;
+};
+
+[[noreturn]] void fail(j_common_ptr info) {
+  std::longjmp(reinterpret_cast<Session*>(info->err)->jump, 1);
+}
+
+void quiet(j_common_ptr) {}
+
+bool startsWith(const jpeg_marker_struct& marker, std::string_view prefix) {
+  return marker.data_length >= prefix.size()
+      && std::memcmp(marker.data, prefix.data(), prefix.size()) == 0;
+}
+
+bool transcode(
+    Session& s,
+    const unsigned char* data,
+    std::size_t size,
+    Strip strip
+) {
+  if (setjmp(s.jump) != 0) {
+    return false;
+  }
+  jpeg_create_decompress(&s.source);
+  jpeg_create_compress(&s.target);
+  jpeg_mem_src(
+      &s.source,
+      const_cast<unsigned char*>(data),
+      static_cast<unsigned long>(size)
+  );
+  jpeg_save_markers(&s.source, JPEG_COM, 0xffff);
+  for (auto app = 0; app < 16; app++) {
+    jpeg_save_markers(&s.source, JPEG_APP0 + app, 0xffff);
+  }
+  jpeg_read_header(&s.source, TRUE);
+  auto* coefficients = jpeg_read_coefficients(&s.source);
+  /// a damaged photo would be "repaired", which is not lossless; the whole
+  /// photo is read by now and the compressor resets the count
+  if (s.error.num_warnings > 0) {
+    return false;
+  }
+  jpeg_copy_critical_parameters(&s.source, &s.target);
+  s.target.optimize_coding = TRUE;
+  if (s.source.progressive_mode) {
+    jpeg_simple_progression(&s.target);
+  }
+  jpeg_mem_dest(&s.target, &s.out, &s.outSize);
+  jpeg_write_coefficients(&s.target, coefficients);
+
+  for (auto* marker = s.source.marker_list; marker; marker = marker->next) {
+    const auto app = static_cast<int>(marker->marker) - JPEG_APP0;
+    /// libjpeg writes its own JFIF and Adobe markers; the previews an MPF
+    /// segment points to follow the image and are not copied
+    if (
+        (app == 0 && s.target.write_JFIF_header && startsWith(*marker, "JFIF"))
+        || (app == 14 && s.target.write_Adobe_marker
+            && startsWith(*marker, "Adobe"))
+        || (app == 2 && startsWith(*marker, std::string_view("MPF\0", 4)))
+    ) {
+      continue;
+    }
+    const auto icc = app == 2
+        && startsWith(*marker, std::string_view("ICC_PROFILE\0", 12));
+    if (strip == Strip::ALL && !icc) {
+      continue;
+    }
+    auto length = static_cast<std::size_t>(marker->data_length);
+    if (strip == Strip::THUMBNAIL && app == 1) {
+      length = exif::stripThumbnail(marker->data, length);
+    }
+    jpeg_write_marker(
+        &s.target,
+        marker->marker,
+        marker->data,
+        static_cast<unsigned int>(length)
+    );
+  }
+
+  jpeg_finish_compress(&s.target);
+  jpeg_finish_decompress(&s.source);
+  return true;
+}
+
+} /// namespace
+
+std::optional<Strip> parseStrip(const std::string& value) {
+  if (value.empty() || value == "none") {
+    return Strip::NONE;
+  }
+  if (value == "thumbnail") {
+    return Strip::THUMBNAIL;
+  }
+  if (value == "all") {
+    return Strip::ALL;
+  }
+  return {};
+}
+
+std::optional<std::string> optimize(
+    const unsigned char* data,
+    std::size_t size,
+    Strip strip
+) {
+  Session session{};
+  session.source.err = jpeg_std_error(&session.error);
+  session.target.err = &session.error;
+  session.error.error_exit = fail;
+  session.error.output_message = quiet;
+
+  std::optional<std::string> ret;
+  if (transcode(session, data, size, strip)) {
+    ret = std::string(reinterpret_cast<char*>(session.out), session.outSize);
+  }
+  jpeg_destroy_compress(&session.target);
+  jpeg_destroy_decompress(&session.source);
+  std::free(session.out);
+  return ret;
+}
+
+} /// namespace jpeg
+
+#endif /// JPEG_JPEG_HH_
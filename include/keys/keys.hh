@@ -0,0 +1,233 @@
+#ifndef KEYS_KEYS_HH_
+#define KEYS_KEYS_HH_
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace keys {
+
+//! Sorted set of keys stored back to back in one string, with one offset
+//! per key. Lookups are binary searches, moving it moves two buffers.
+//!
+//! Listings arrive in key order, so keys are normally appended with
+//! 'push_back' as they come; 'sort' puts keys added out of order in place
+//! and drops duplicates.
+class Keys {
+public:
+  class const_iterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = std::string_view;
+
+    const_iterator() = default;
+    const_iterator(const Keys* keys, std::size_t i);
+    std::string_view operator*() const;
+    std::string_view operator[](difference_type n) const;
+    const_iterator& operator++();
+    const_iterator operator++(int);
+    const_iterator& operator--();
+    const_iterator& operator+=(difference_type n);
+    const_iterator operator+(difference_type n) const;
+    difference_type operator-(const const_iterator& other) const;
+    bool operator==(const const_iterator& other) const;
+    bool operator!=(const const_iterator& other) const;
+    bool operator<(const const_iterator& other) const;
+  protected:
+    const Keys* keys_ = nullptr;
+    std::size_t i_ = 0;
+  private:
+  };
+  using value_type = std::string_view;
+
+  Keys();
+  void reserve(std::size_t keys, std::size_t bytes);
+  void push_back(std::string_view key);
+  void sort();
+  std::size_t size() const;
+  bool empty() const;
+  std::string_view operator[](std::size_t i) const;
+  const_iterator begin() const;
+  const_iterator end() const;
+  const_iterator find(std::string_view key) const;
+  bool contains(std::string_view key) const;
+  //! keys starting with 'prefix'
+  std::pair<const_iterator, const_iterator> prefixed(
+      std::string_view prefix
+  ) const;
+protected:
+  std::size_t lowerBound(std::string_view key) const;
+
+  std::string arena_;
+  /// key 'i' is [offsets_[i], offsets_[i + 1]) of 'arena_'
+  std::vector<std::size_t> offsets_;
+  bool sorted_ = true;
+private:
+};
+
+} /// namespace keys
+
+/// implementation
+
+namespace keys {
+
+Keys::const_iterator::const_iterator(const Keys* keys, std::size_t i)
+    : keys_(keys), i_(i) {}
+
+std::string_view Keys::const_iterator::operator*() const {
+  return (*keys_)[i_];
+}
+
+std::string_view Keys::const_iterator::operator[](difference_type n) const {
+  return (*keys_)[i_ + n];
+}
+
+Keys::const_iterator& Keys::const_iterator::operator++() {
+  i_++;
+  return *this;
+}
+
+Keys::const_iterator Keys::const_iterator::operator++(int) {
+  auto ret = *this;
+  i_++;
+  return ret;
+}
+
+Keys::const_iterator& Keys::const_iterator::operator--() {
+  i_--;
+  return *this;
+}
+
+Keys::const_iterator& Keys::const_iterator::operator+=(difference_type n) {
+  i_ += n;
+  return *this;
+}
+
+Keys::const_iterator Keys::const_iterator::operator+(
+    difference_type n
+) const {
+  return const_iterator(keys_, i_ + n);
+}
+
+Keys::const_iterator::difference_type Keys::const_iterator::operator-(
+    const const_iterator& other
+) const {
+  return static_cast<difference_type>(i_)
+      - static_cast<difference_type>(other.i_);
+}
+
+bool Keys::const_iterator::operator==(const const_iterator& other) const {
+  return i_ == other.i_;
+}
+
+bool Keys::const_iterator::operator!=(const const_iterator& other) const {
+  return i_ != other.i_;
+}
+
+bool Keys::const_iterator::operator<(const const_iterator& other) const {
+  return i_ < other.i_;
+}
+
+Keys::Keys() : offsets_{0} {}
+
+void Keys::reserve(std::size_t keys, std::size_t bytes) {
+  offsets_.reserve(keys + 1);
+  arena_.reserve(bytes);
+}
+
+void Keys::push_back(std::string_view key) {
+  if (sorted_ && !empty() && key <= (*this)[size() - 1]) {
+    sorted_ = false;
+  }
+  arena_.append(key);
+  offsets_.push_back(arena_.size());
+}
+
+void Keys::sort() {
+  if (sorted_) {
+    return;
+  }
+  std::vector<std::size_t> order(size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](auto lhs, auto rhs) {
+    return (*this)[lhs] < (*this)[rhs];
+  });
+
+  Keys ret;
+  ret.reserve(size(), arena_.size());
+  for (const auto i : order) {
+    if (ret.empty() || ret[ret.size() - 1] != (*this)[i]) {
+      ret.push_back((*this)[i]);
+    }
+  }
+  *this = std::move(ret);
+}
+
+std::size_t Keys::size() const { return offsets_.size() - 1; }
+
+bool Keys::empty() const { return size() == 0; }
+
+std::string_view Keys::operator[](std::size_t i) const {
+  return std::string_view(arena_).substr(
+      offsets_[i], offsets_[i + 1] - offsets_[i]
+  );
+}
+
+Keys::const_iterator Keys::begin() const { return const_iterator(this, 0); }
+
+Keys::const_iterator Keys::end() const {
+  return const_iterator(this, size());
+}
+
+Keys::const_iterator Keys::find(std::string_view key) const {
+  const auto i = lowerBound(key);
+  return i < size() && (*this)[i] == key ? begin() + i : end();
+}
+
+bool Keys::contains(std::string_view key) const {
+  return find(key) != end();
+}
+
+std::pair<Keys::const_iterator, Keys::const_iterator> Keys::prefixed(
+    std::string_view prefix
+) const {
+  const auto first = lowerBound(prefix);
+  auto last = first;
+  /// binary search for the first key past the prefix as well
+  for (auto count = size() - first; count > 0;) {
+    const auto half = count / 2;
+    if ((*this)[last + half].substr(0, prefix.size()) == prefix) {
+      last += half + 1;
+      count -= half + 1;
+    } else {
+      count = half;
+    }
+  }
+  return {begin() + first, begin() + last};
+}
+
+std::size_t Keys::lowerBound(std::string_view key) const {
+  std::size_t first = 0;
+  for (auto count = size(); count > 0;) {
+    const auto half = count / 2;
+    if ((*this)[first + half] < key) {
+      first += half + 1;
+      count -= half + 1;
+    } else {
+      count = half;
+    }
+  }
+  return first;
+}
+
+} /// namespace keys
+
+#endif /// KEYS_KEYS_HH_
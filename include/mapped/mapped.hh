@@ -0,0 +1,92 @@
+#ifndef MAPPED_MAPPED_HH_
+#define MAPPED_MAPPED_HH_
+
+#include <cstddef>
+#include <filesystem>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mapped {
+
+//! Read-only, sequentially advised memory mapping of a whole file
+class File {
+public:
+  explicit File(const std::filesystem::path& path);
+  File(const File&) = delete;
+  File& operator=(const File&) = delete;
+  ~File();
+  const unsigned char* data() const;
+  std::size_t size() const;
+  explicit operator bool() const;
+  //! drops already consumed pages so a huge file does not stay resident
+  void release(std::size_t offset, std::size_t length) const;
+protected:
+  unsigned char* data_ = nullptr;
+  std::size_t size_ = 0;
+  bool ok_ = false;
+private:
+};
+
+} /// namespace mapped
+
+/// implementation
+
+namespace mapped {
+
+#ifdef __linux__
+File::File(const std::filesystem::path& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st {};
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    return;
+  }
+  size_ = static_cast<std::size_t>(st.st_size);
+  if (size_ > 0) {
+    void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      return;
+    }
+    data_ = static_cast<unsigned char*>(data);
+    ::madvise(data_, size_, MADV_SEQUENTIAL);
+  }
+  ::close(fd);
+  ok_ = true;
+}
+
+File::~File() {
+  if (data_ != nullptr) {
+    ::munmap(data_, size_);
+  }
+}
+
+void File::release(std::size_t offset, std::size_t length) const {
+  const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  const auto begin = offset / page * page;
+  if (data_ == nullptr || begin >= offset + length) {
+    return;
+  }
+  ::madvise(data_ + begin, offset + length - begin, MADV_DONTNEED);
+}
+#else
+#error your OS is not supported
+#endif
+
+const unsigned char* File::data() const { return data_; }
+
+std::size_t File::size() const { return size_; }
+
+File::operator bool() const { return ok_; }
+
+} /// namespace mapped
+
+#endif /// MAPPED_MAPPED_HH_
@@ -0,0 +1,257 @@
+#ifndef MD5_MD5_HH_
+#define MD5_MD5_HH_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace md5 {
+
+using Digest = std::array<unsigned char, 16>;
+
+//! Incremental MD5 (RFC 1321)
+class Md5 {
+public:
+  Md5();
+  Md5& update(const void* data, std::size_t size);
+  Digest digest();
+protected:
+  void block(const unsigned char* data);
+
+  std::array<std::uint32_t, 4> state_;
+  std::array<unsigned char, 64> buffer_;
+  std::size_t buffered_ = 0;
+  std::uint64_t total_ = 0;
+private:
+};
+
+Digest digest(const void* data, std::size_t size);
+
+//! number of buffers 'digests' hashes side by side
+constexpr std::size_t LANES = 4;
+
+//! digests of 'LANES' buffers of the same size, computed together in the
+//! lanes of one vector register where the compiler supports it
+std::array<Digest, LANES> digests(
+    const unsigned char* const* data,
+    std::size_t size
+);
+
+std::string hex(const Digest& digest);
+
+} /// namespace md5
+
+/// implementation
+
+namespace md5 {
+
+namespace {
+
+constexpr std::uint32_t K[64] = {
+  0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+  0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+  0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+  0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+  0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+  0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+  0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+  0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+  0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+  0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+  0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+  0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+  0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+  0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+  0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+  0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+constexpr unsigned S[64] = {
+  7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+  5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+  4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+  6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+/// index of the message word used by round step 'i'
+constexpr unsigned word(unsigned i) {
+  return i < 16 ? i
+      : i < 32 ? (5 * i + 1) % 16
+      : i < 48 ? (3 * i + 5) % 16
+      : (7 * i) % 16;
+}
+
+std::uint32_t load(const unsigned char* data) {
+  return static_cast<std::uint32_t>(data[0])
+      | (static_cast<std::uint32_t>(data[1]) << 8)
+      | (static_cast<std::uint32_t>(data[2]) << 16)
+      | (static_cast<std::uint32_t>(data[3]) << 24);
+}
+
+/// one MD5 block, 'T' is either a single word or a vector of words
+template <typename T>
+void compress(T* state, const T* m) {
+  auto a = state[0];
+  auto b = state[1];
+  auto c = state[2];
+  auto d = state[3];
+  for (auto i = 0u; i < 64; i++) {
+    T f;
+    if (i < 16) {
+      f = (b & c) | (~b & d);
+    } else if (i < 32) {
+      f = (d & b) | (~d & c);
+    } else if (i < 48) {
+      f = b ^ c ^ d;
+    } else {
+      f = c ^ (b | ~d);
+    }
+    f += a + K[i] + m[word(i)];
+    a = d;
+    d = c;
+    c = b;
+    b += (f << S[i]) | (f >> (32 - S[i]));
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+}
+
+#if defined(__GNUC__)
+using Lanes = std::uint32_t __attribute__((vector_size(4 * LANES)));
+#endif
+
+} /// namespace
+
+Md5::Md5()
+    : state_{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476} {}
+
+Md5& Md5::update(const void* data, std::size_t size) {
+  auto* bytes = static_cast<const unsigned char*>(data);
+  total_ += size;
+  if (buffered_ > 0) {
+    const auto take = std::min(size, buffer_.size() - buffered_);
+    std::memcpy(buffer_.data() + buffered_, bytes, take);
+    buffered_ += take;
+    bytes += take;
+    size -= take;
+    if (buffered_ < buffer_.size()) {
+      return *this;
+    }
+    block(buffer_.data());
+    buffered_ = 0;
+  }
+  for (; size >= buffer_.size(); bytes += 64, size -= 64) {
+    block(bytes);
+  }
+  std::memcpy(buffer_.data(), bytes, size);
+  buffered_ = size;
+  return *this;
+}
+
+Digest Md5::digest() {
+  const auto bits = total_ * 8;
+  const unsigned char pad = 0x80;
+  update(&pad, 1);
+  const unsigned char zero = 0;
+  while (buffered_ != 56) {
+    update(&zero, 1);
+  }
+  unsigned char length[8];
+  for (auto i = 0u; i < 8; i++) {
+    length[i] = static_cast<unsigned char>(bits >> (8 * i));
+  }
+  update(length, sizeof(length));
+
+  Digest ret;
+  for (auto i = 0u; i < 16; i++) {
+    ret[i] = static_cast<unsigned char>(state_[i / 4] >> (8 * (i % 4)));
+  }
+  return ret;
+}
+
+void Md5::block(const unsigned char* data) {
+  std::uint32_t m[16];
+  for (auto i = 0u; i < 16; i++) {
+    m[i] = load(data + i * 4);
+  }
+  compress(state_.data(), m);
+}
+
+Digest digest(const void* data, std::size_t size) {
+  return Md5().update(data, size).digest();
+}
+
+std::array<Digest, LANES> digests(
+    const unsigned char* const* data,
+    std::size_t size
+) {
+  std::array<Digest, LANES> ret;
+#if defined(__GNUC__)
+  /// every lane gets the same padding, so the tail blocks are built once per
+  /// lane and hashed in lockstep like the body
+  const auto full = size / 64;
+  const auto rest = size % 64;
+  const auto tailBlocks = rest < 56 ? 1u : 2u;
+  unsigned char tails[LANES][128] = {};
+  for (auto l = 0u; l < LANES; l++) {
+    std::memcpy(tails[l], data[l] + full * 64, rest);
+    tails[l][rest] = 0x80;
+    const auto bits = static_cast<std::uint64_t>(size) * 8;
+    for (auto i = 0u; i < 8; i++) {
+      tails[l][tailBlocks * 64 - 8 + i] =
+          static_cast<unsigned char>(bits >> (8 * i));
+    }
+  }
+
+  Lanes state[4];
+  for (auto l = 0u; l < LANES; l++) {
+    state[0][l] = 0x67452301;
+    state[1][l] = 0xefcdab89;
+    state[2][l] = 0x98badcfe;
+    state[3][l] = 0x10325476;
+  }
+  Lanes m[16];
+  for (std::size_t block = 0; block < full + tailBlocks; block++) {
+    for (auto l = 0u; l < LANES; l++) {
+      const auto* bytes = block < full
+          ? data[l] + block * 64
+          : tails[l] + (block - full) * 64;
+      for (auto i = 0u; i < 16; i++) {
+        m[i][l] = load(bytes + i * 4);
+      }
+    }
+    compress(state, m);
+  }
+
+  for (auto l = 0u; l < LANES; l++) {
+    for (auto i = 0u; i < 16; i++) {
+      ret[l][i] =
+          static_cast<unsigned char>(state[i / 4][l] >> (8 * (i % 4)));
+    }
+  }
+#else
+  for (auto l = 0u; l < LANES; l++) {
+    ret[l] = digest(data[l], size);
+  }
+#endif
+  return ret;
+}
+
+std::string hex(const Digest& digest) {
+  constexpr char digits[] = "0123456789abcdef";
+  std::string ret;
+  for (const auto byte : digest) {
+    ret += digits[byte >> 4];
+    ret += digits[byte & 0x0f];
+  }
+  return ret;
+}
+
+} /// namespace md5
+
+#endif /// MD5_MD5_HH_
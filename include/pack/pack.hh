@@ -0,0 +1,198 @@
+#ifndef PACK_PACK_HH_
+#define PACK_PACK_HH_
+
+#include <md5/md5.hh>
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace pack {
+
+//! one photo stored inside a pack object
+struct Entry {
+  std::string name;
+  std::uint32_t pack = 0;
+  std::uint64_t offset = 0;
+  std::uint64_t length = 0;
+  md5::Digest hash{};
+};
+
+//! Index object of a packed album, maps photo names to byte ranges of the
+//! pack objects.
+//!
+//! Layout (little endian):
+//!   "CPPK" u8:version u32:packs u32:entries
+//!   entries * (u16:nameLength name u32:pack u64:offset u64:length 16:md5)
+class Index {
+public:
+  using value_type = std::vector<Entry>;
+  std::uint32_t packs() const;
+  const value_type& entries() const;
+  //! appends pack 'pack' made of 'entries', replacing photos of the same
+  //! name; the packs are counted up to it
+  void add(value_type entries, std::uint32_t pack);
+  //! appends all packs of 'other' after the packs of this index
+  void merge(const Index& other);
+  bool remove(const std::string& name);
+  std::string serialize() const;
+  static std::optional<Index> parse(std::string_view data);
+protected:
+  void append(value_type entries);
+
+  std::uint32_t packs_ = 0;
+  value_type entries_;
+
+  static constexpr std::string_view MAGIC = "CPPK";
+  static constexpr std::uint8_t VERSION = 1;
+private:
+};
+
+} /// namespace pack
+
+/// implementation
+
+namespace pack {
+
+namespace {
+
+template <typename T>
+void write(std::string& out, T value) {
+  for (auto i = 0u; i < sizeof(T); i++) {
+    out += static_cast<char>(
+        (static_cast<std::uint64_t>(value) >> (8 * i)) & 0xff
+    );
+  }
+}
+
+template <typename T>
+bool read(std::string_view& in, T& value) {
+  if (in.size() < sizeof(T)) {
+    return false;
+  }
+  std::uint64_t ret = 0;
+  for (auto i = 0u; i < sizeof(T); i++) {
+    ret |= static_cast<std::uint64_t>(
+        static_cast<unsigned char>(in[i])
+    ) << (8 * i);
+  }
+  value = static_cast<T>(ret);
+  in.remove_prefix(sizeof(T));
+  return true;
+}
+
+} /// namespace
+
+std::uint32_t Index::packs() const { return packs_; }
+
+const Index::value_type& Index::entries() const { return entries_; }
+
+void Index::add(value_type entries, std::uint32_t pack) {
+  packs_ = std::max(packs_, pack + 1);
+  for (auto& entry : entries) {
+    entry.pack = pack;
+  }
+  append(std::move(entries));
+}
+
+void Index::merge(const Index& other) {
+  auto entries = other.entries_;
+  for (auto& entry : entries) {
+    entry.pack += packs_;
+  }
+  packs_ += other.packs_;
+  append(std::move(entries));
+}
+
+bool Index::remove(const std::string& name) {
+  const auto it = std::find_if(
+      entries_.begin(),
+      entries_.end(),
+      [&name](const Entry& entry) { return entry.name == name; }
+  );
+  if (it == entries_.end()) {
+    return false;
+  }
+  entries_.erase(it);
+  return true;
+}
+
+void Index::append(value_type entries) {
+  std::unordered_set<std::string_view> names;
+  for (const auto& entry : entries) {
+    names.insert(entry.name);
+  }
+  entries_.erase(
+      std::remove_if(
+          entries_.begin(),
+          entries_.end(),
+          [&names](const Entry& entry) { return names.count(entry.name) > 0; }
+      ),
+      entries_.end()
+  );
+  std::move(entries.begin(), entries.end(), std::back_inserter(entries_));
+}
+
+std::string Index::serialize() const {
+  std::string ret(MAGIC);
+  write(ret, VERSION);
+  write(ret, packs_);
+  write(ret, static_cast<std::uint32_t>(entries_.size()));
+  for (const auto& entry : entries_) {
+    write(ret, static_cast<std::uint16_t>(entry.name.size()));
+    ret += entry.name;
+    write(ret, entry.pack);
+    write(ret, entry.offset);
+    write(ret, entry.length);
+    ret.append(entry.hash.begin(), entry.hash.end());
+  }
+  return ret;
+}
+
+std::optional<Index> Index::parse(std::string_view data) {
+  if (data.substr(0, MAGIC.size()) != MAGIC) {
+    return {};
+  }
+  data.remove_prefix(MAGIC.size());
+
+  Index ret;
+  std::uint8_t version = 0;
+  std::uint32_t count = 0;
+  if (
+      !read(data, version)
+      || version != VERSION
+      || !read(data, ret.packs_)
+      || !read(data, count)
+  ) {
+    return {};
+  }
+  for (auto i = 0u; i < count; i++) {
+    Entry entry;
+    std::uint16_t nameLength = 0;
+    if (!read(data, nameLength) || data.size() < nameLength) {
+      return {};
+    }
+    entry.name = std::string(data.substr(0, nameLength));
+    data.remove_prefix(nameLength);
+    if (
+        !read(data, entry.pack)
+        || !read(data, entry.offset)
+        || !read(data, entry.length)
+        || data.size() < entry.hash.size()
+    ) {
+      return {};
+    }
+    std::copy_n(data.begin(), entry.hash.size(), entry.hash.begin());
+    data.remove_prefix(entry.hash.size());
+    ret.entries_.push_back(std::move(entry));
+  }
+  return ret;
+}
+
+} /// namespace pack
+
+#endif /// PACK_PACK_HH_
@@ -0,0 +1,236 @@
+#ifndef PARALLEL_PARALLEL_HH_
+#define PARALLEL_PARALLEL_HH_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+//! Calls 'task(i)' for every i in [0, count) on up to 'workers' threads,
+//! stops handing out new indices after the first failed task. A call made
+//! by a task runs on the threads of the outermost call: it starts a thread
+//! only for one the outermost call did not need or is done with, so nested
+//! calls never run more threads than the outermost one was given.
+template <typename Task>
+bool forEach(std::size_t count, std::size_t workers, Task&& task);
+
+template <typename Item>
+class Queue;
+
+//! Calls 'task(item, queue)' for every item of 'items' and every item a
+//! task pushes to 'queue', on up to 'workers' threads started as the work
+//! grows; stops handing out items after the first failed task
+template <typename Item, typename Task>
+bool drain(std::vector<Item> items, std::size_t workers, Task&& task);
+
+//! Work list of 'drain', the running tasks may add to it
+template <typename Item>
+class Queue {
+public:
+  explicit Queue(std::size_t workers);
+  Queue(const Queue&) = delete;
+  Queue& operator=(const Queue&) = delete;
+  //! hands 'item' to an idle worker, starting one if none is idle
+  void push(Item item);
+  //! workers that would have nothing to do, were every pending item
+  //! handed out
+  std::size_t spare() const;
+protected:
+  template <typename T, typename Task>
+  friend bool drain(std::vector<T> items, std::size_t workers, Task&& task);
+  //! next item, nothing once every item is done or one failed
+  std::optional<Item> pop();
+  void done(bool ok);
+
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<Item> items_;
+  std::size_t pending_ = 0; /// waiting or being worked on
+  std::size_t workers_;
+  std::size_t running_ = 1; /// the caller of 'drain' works too
+  bool ok_ = true;
+  std::function<void()> work_;
+  std::vector<std::thread> threads_;
+private:
+};
+
+//! threads the outermost 'forEach' running on the calling thread can still
+//! lend to nested calls, nothing outside of one
+std::atomic<std::size_t>*& spare();
+
+//! Lets at most 'count' threads at a time between 'acquire' and 'release',
+//! for stages that need fewer threads than the transfers around them
+class Semaphore {
+public:
+  explicit Semaphore(std::size_t count);
+  Semaphore(const Semaphore&) = delete;
+  Semaphore& operator=(const Semaphore&) = delete;
+  void acquire();
+  void release();
+protected:
+  std::mutex mutex_;
+  std::condition_variable released_;
+  std::size_t count_;
+private:
+};
+
+} /// namespace parallel
+
+/// implementation
+
+namespace parallel {
+
+template <typename Task>
+bool forEach(std::size_t count, std::size_t workers, Task&& task) {
+  std::atomic<std::size_t> next = 0;
+  std::atomic<bool> ok = true;
+
+  const auto work = [&]() {
+    for (auto i = next++; i < count && ok; i = next++) {
+      if (!task(i)) {
+        ok = false;
+      }
+    }
+  };
+
+  workers = std::max<std::size_t>(workers, 1);
+  const auto wanted = std::min(workers, count);
+  /// the outermost call lends the threads it does not need itself
+  auto* const outer = spare();
+  std::atomic<std::size_t> own = workers - std::min(workers, count);
+  auto* const shared = outer != nullptr ? outer : &own;
+  const auto worker = [&]() {
+    spare() = shared;
+    work();
+    (*shared)++;
+  };
+
+  std::vector<std::thread> threads;
+  for (auto i = 1u; i < wanted; i++) {
+    if (outer != nullptr) {
+      auto available = shared->load();
+      while (
+          available > 0
+          && !shared->compare_exchange_weak(available, available - 1)
+      ) {}
+      if (available == 0) {
+        break;
+      }
+    }
+    threads.emplace_back(worker);
+  }
+  spare() = shared;
+  work();
+  spare() = outer;
+  if (outer == nullptr) {
+    /// the caller is done, a nested call may take its place
+    own++;
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  return ok;
+}
+
+template <typename Item, typename Task>
+bool drain(std::vector<Item> items, std::size_t workers, Task&& task) {
+  Queue<Item> queue(workers);
+  queue.work_ = [&]() {
+    for (auto item = queue.pop(); item.has_value(); item = queue.pop()) {
+      queue.done(task(item.value(), queue));
+    }
+  };
+  for (auto& item : items) {
+    queue.push(std::move(item));
+  }
+  queue.work_();
+  /// no thread is started once the caller stopped, every item is done or
+  /// one failed
+  for (auto& thread : queue.threads_) {
+    thread.join();
+  }
+  return queue.ok_;
+}
+
+template <typename Item>
+Queue<Item>::Queue(std::size_t workers)
+    : workers_(std::max<std::size_t>(workers, 1)) {}
+
+template <typename Item>
+void Queue<Item>::push(Item item) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    items_.push_back(std::move(item));
+    pending_++;
+    if (ok_ && pending_ > running_ && running_ < workers_ && work_) {
+      threads_.emplace_back(work_);
+      running_++;
+    }
+  }
+  changed_.notify_one();
+}
+
+template <typename Item>
+std::size_t Queue<Item>::spare() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return workers_ > pending_ ? workers_ - pending_ : 0;
+}
+
+template <typename Item>
+std::optional<Item> Queue<Item>::pop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this]() {
+    return !items_.empty() || pending_ == 0 || !ok_;
+  });
+  if (items_.empty() || !ok_) {
+    return {};
+  }
+  auto ret = std::move(items_.front());
+  items_.pop_front();
+  return ret;
+}
+
+template <typename Item>
+void Queue<Item>::done(bool ok) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_--;
+    ok_ = ok_ && ok;
+  }
+  changed_.notify_all();
+}
+
+std::atomic<std::size_t>*& spare() {
+  thread_local std::atomic<std::size_t>* ret = nullptr;
+  return ret;
+}
+
+Semaphore::Semaphore(std::size_t count)
+    : count_(std::max<std::size_t>(count, 1)) {}
+
+void Semaphore::acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  released_.wait(lock, [this]() { return count_ > 0; });
+  count_--;
+}
+
+void Semaphore::release() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    count_++;
+  }
+  released_.notify_one();
+}
+
+} /// namespace parallel
+
+#endif /// PARALLEL_PARALLEL_HH_
@@ -0,0 +1,175 @@
+#ifndef POOL_POOL_HH_
+#define POOL_POOL_HH_
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace pool {
+
+class Pool;
+
+//! Move-only lease of one slab, gives the slab back to its pool when
+//! destroyed
+class Slab {
+public:
+  Slab() = default;
+  Slab(Slab&& other) noexcept;
+  Slab& operator=(Slab&& other) noexcept;
+  Slab(const Slab&) = delete;
+  Slab& operator=(const Slab&) = delete;
+  ~Slab();
+  unsigned char* data() const;
+  std::size_t capacity() const;
+  explicit operator bool() const;
+protected:
+  friend class Pool;
+  Slab(Pool* pool, unsigned char* data);
+  void reset();
+
+  Pool* pool_ = nullptr;
+  unsigned char* data_ = nullptr;
+private:
+};
+
+//! Fixed arena of 'slabs' page aligned buffers of 'slabSize' bytes each,
+//! 'acquire' blocks while every slab is leased
+class Pool {
+public:
+  Pool(std::size_t slabs, std::size_t slabSize);
+  Pool(const Pool&) = delete;
+  Pool& operator=(const Pool&) = delete;
+  ~Pool();
+  Slab acquire();
+  //! an empty slab if none is free right now
+  Slab tryAcquire();
+  std::size_t slabs() const;
+  std::size_t slabSize() const;
+protected:
+  friend class Slab;
+  void release(unsigned char* data);
+
+  unsigned char* arena_ = nullptr;
+  std::size_t slabs_ = 0;
+  std::size_t slabSize_ = 0;
+  std::vector<unsigned char*> free_;
+  std::mutex mutex_;
+  std::condition_variable released_;
+private:
+};
+
+} /// namespace pool
+
+/// implementation
+
+namespace pool {
+
+Slab::Slab(Pool* pool, unsigned char* data) : pool_(pool), data_(data) {}
+
+Slab::Slab(Slab&& other) noexcept : pool_(other.pool_), data_(other.data_) {
+  other.pool_ = nullptr;
+  other.data_ = nullptr;
+}
+
+Slab& Slab::operator=(Slab&& other) noexcept {
+  if (this != &other) {
+    reset();
+    pool_ = other.pool_;
+    data_ = other.data_;
+    other.pool_ = nullptr;
+    other.data_ = nullptr;
+  }
+  return *this;
+}
+
+Slab::~Slab() { reset(); }
+
+unsigned char* Slab::data() const { return data_; }
+
+std::size_t Slab::capacity() const {
+  return pool_ == nullptr ? 0 : pool_->slabSize();
+}
+
+Slab::operator bool() const { return data_ != nullptr; }
+
+void Slab::reset() {
+  if (pool_ != nullptr && data_ != nullptr) {
+    pool_->release(data_);
+  }
+  pool_ = nullptr;
+  data_ = nullptr;
+}
+
+#ifdef __linux__
+Pool::Pool(std::size_t slabs, std::size_t slabSize) : slabs_(slabs) {
+  if (slabs == 0 || slabSize == 0) {
+    throw std::invalid_argument("Pool must have at least one non-empty slab");
+  }
+  const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  slabSize_ = (slabSize + page - 1) / page * page;
+  /// anonymous mapping is page aligned and is not resident until touched
+  void* arena = mmap(
+      nullptr,
+      slabs_ * slabSize_,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0
+  );
+  if (arena == MAP_FAILED) {
+    throw std::runtime_error("Can not allocate buffer pool");
+  }
+  arena_ = static_cast<unsigned char*>(arena);
+  free_.reserve(slabs_);
+  for (auto i = slabs_; i > 0; i--) {
+    free_.push_back(arena_ + (i - 1) * slabSize_);
+  }
+}
+
+Pool::~Pool() {
+  munmap(arena_, slabs_ * slabSize_);
+}
+#else
+#error your OS is not supported
+#endif
+
+Slab Pool::acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  released_.wait(lock, [this]() { return !free_.empty(); });
+  auto* data = free_.back();
+  free_.pop_back();
+  return Slab(this, data);
+}
+
+Slab Pool::tryAcquire() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_.empty()) {
+    return Slab();
+  }
+  auto* data = free_.back();
+  free_.pop_back();
+  return Slab(this, data);
+}
+
+std::size_t Pool::slabs() const { return slabs_; }
+
+std::size_t Pool::slabSize() const { return slabSize_; }
+
+void Pool::release(unsigned char* data) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(data);
+  }
+  released_.notify_one();
+}
+
+} /// namespace pool
+
+#endif /// POOL_POOL_HH_
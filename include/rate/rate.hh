@@ -0,0 +1,157 @@
+#ifndef RATE_RATE_HH_
+#define RATE_RATE_HH_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace rate {
+
+//! transfers of a higher priority class (lower value) take bandwidth first
+enum class Priority {
+  INTERACTIVE, /// metadata requests and small objects
+  BULK, /// large bodies
+};
+
+constexpr std::size_t PRIORITIES = 2;
+
+//! priority of the transfers issued by the calling thread
+Priority current();
+
+//! Sets the priority of the calling thread's transfers for its lifetime
+class Scope {
+public:
+  explicit Scope(Priority priority);
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+  ~Scope();
+protected:
+  Priority previous_;
+private:
+};
+
+//! Token bucket shared by every transfer of one direction. Tokens are bytes
+//! refilled at 'rate' per second, up to 'BURST' worth of them. A transfer
+//! may overdraw the bucket, the next one then waits until the debt is paid,
+//! and bulk transfers wait while interactive ones are waiting.
+class Bucket {
+public:
+  //! 'rate' in bytes per second, 0 is unlimited
+  explicit Bucket(std::size_t rate = 0);
+  Bucket(const Bucket&) = delete;
+  Bucket& operator=(const Bucket&) = delete;
+  //! may be called while transfers are running
+  void setRate(std::size_t rate);
+  std::size_t rate() const;
+  //! blocks until 'bytes' may be transferred with 'priority'
+  void acquire(std::size_t bytes, Priority priority);
+  //! how long transferring 'bytes' would have to wait now
+  std::chrono::milliseconds delay(std::size_t bytes) const;
+protected:
+  using Clock = std::chrono::steady_clock;
+
+  double available(Clock::time_point now) const;
+  double capacity() const;
+
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::size_t rate_ = 0;
+  double tokens_ = 0;
+  Clock::time_point refilled_;
+  std::size_t waiting_[PRIORITIES] = {};
+
+  static constexpr std::chrono::milliseconds BURST{100};
+private:
+};
+
+} /// namespace rate
+
+/// implementation
+
+namespace rate {
+
+namespace {
+
+thread_local Priority priority = Priority::INTERACTIVE;
+
+} /// namespace
+
+Priority current() { return priority; }
+
+Scope::Scope(Priority value) : previous_(priority) { priority = value; }
+
+Scope::~Scope() { priority = previous_; }
+
+Bucket::Bucket(std::size_t rate) : rate_(rate), refilled_(Clock::now()) {
+  tokens_ = capacity();
+}
+
+void Bucket::setRate(std::size_t rate) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = Clock::now();
+    tokens_ = available(now);
+    refilled_ = now;
+    rate_ = rate;
+    tokens_ = std::min(tokens_, capacity());
+  }
+  changed_.notify_all();
+}
+
+std::size_t Bucket::rate() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rate_;
+}
+
+void Bucket::acquire(std::size_t bytes, Priority priority) {
+  const auto index = static_cast<std::size_t>(priority);
+  std::unique_lock<std::mutex> lock(mutex_);
+  waiting_[index]++;
+  while (rate_ > 0) {
+    const auto now = Clock::now();
+    tokens_ = available(now);
+    refilled_ = now;
+    const auto yields = priority == Priority::BULK
+        && waiting_[static_cast<std::size_t>(Priority::INTERACTIVE)] > 0;
+    if (!yields && tokens_ > 0) {
+      break;
+    }
+    /// a yielding transfer is woken by the one it yields to
+    const auto wait = yields
+        ? std::chrono::duration<double>(BURST)
+        : std::chrono::duration<double>((1 - tokens_) / rate_);
+    changed_.wait_for(lock, wait);
+  }
+  waiting_[index]--;
+  if (rate_ > 0) {
+    tokens_ -= static_cast<double>(bytes);
+  }
+  lock.unlock();
+  changed_.notify_all();
+}
+
+std::chrono::milliseconds Bucket::delay(std::size_t bytes) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (rate_ == 0) {
+    return std::chrono::milliseconds(0);
+  }
+  const auto missing = static_cast<double>(bytes) - available(Clock::now());
+  return std::chrono::milliseconds(static_cast<long long>(
+      std::max(0.0, missing) * 1000 / rate_
+  ));
+}
+
+double Bucket::available(Clock::time_point now) const {
+  const std::chrono::duration<double> elapsed = now - refilled_;
+  return std::min(capacity(), tokens_ + elapsed.count() * rate_);
+}
+
+double Bucket::capacity() const {
+  return std::chrono::duration<double>(BURST).count() * rate_;
+}
+
+} /// namespace rate
+
+#endif /// RATE_RATE_HH_
@@ -0,0 +1,240 @@
+#ifndef TAR_TAR_HH_
+#define TAR_TAR_HH_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#ifdef __linux__
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace tar {
+
+//! header of one archive member
+struct Entry {
+  std::string name;
+  std::size_t size = 0;
+  bool regular = false;
+};
+
+//! One pass reader of a ustar/GNU/pax archive coming from a pipe or a file.
+//! Only headers and the current member's data are read, nothing is
+//! buffered beyond a 512 byte block.
+class Reader {
+public:
+  explicit Reader(int fd);
+  //! header of the next member, skipping whatever is left of the current
+  //! one; nothing at the end of the archive or on an error, see 'good'
+  std::optional<Entry> next();
+  //! reads the next 'length' bytes of the current member's data
+  bool read(unsigned char* buffer, std::size_t length);
+  bool good() const;
+protected:
+  bool readAll(void* buffer, std::size_t size);
+  bool skip(std::size_t size);
+  //! data of a member that describes the next one (long name, pax header)
+  std::optional<std::string> body(std::size_t size);
+
+  int fd_;
+  std::size_t remaining_ = 0;
+  std::size_t padding_ = 0;
+  bool good_ = true;
+
+  static constexpr std::size_t BLOCK = 512;
+  /// long names and pax headers larger than this are rejected
+  static constexpr std::size_t MAX_BODY = 1024 * 1024;
+private:
+};
+
+} /// namespace tar
+
+/// implementation
+
+namespace tar {
+
+namespace {
+
+/// octal, or base-256 when the top bit of the first byte is set (GNU)
+std::optional<std::uint64_t> number(
+    const unsigned char* field,
+    std::size_t size
+) {
+  std::uint64_t ret = 0;
+  if (field[0] & 0x80) {
+    for (auto i = 0u; i < size; i++) {
+      ret = (ret << 8) | (i == 0 ? field[0] & 0x7f : field[i]);
+    }
+    return ret;
+  }
+  auto i = 0u;
+  for (; i < size && field[i] == ' '; i++) {}
+  for (; i < size && field[i] >= '0' && field[i] <= '7'; i++) {
+    ret = (ret << 3) | (field[i] - '0');
+  }
+  if (i < size && field[i] != ' ' && field[i] != '\0') {
+    return {};
+  }
+  return ret;
+}
+
+std::string text(const unsigned char* field, std::size_t size) {
+  const auto* end = std::find(field, field + size, '\0');
+  return std::string(field, end);
+}
+
+} /// namespace
+
+Reader::Reader(int fd) : fd_(fd) {}
+
+std::optional<Entry> Reader::next() {
+  if (!good_ || !skip(remaining_ + padding_)) {
+    good_ = false;
+    return {};
+  }
+  remaining_ = 0;
+  padding_ = 0;
+
+  std::optional<std::string> longName;
+  std::optional<std::size_t> paxSize;
+  while (true) {
+    unsigned char header[BLOCK];
+    if (!readAll(header, BLOCK)) {
+      good_ = false;
+      return {};
+    }
+    /// the archive ends with zero blocks
+    if (std::all_of(header, header + BLOCK, [](auto c) { return c == 0; })) {
+      return {};
+    }
+
+    std::uint64_t sum = 0;
+    for (auto i = 0u; i < BLOCK; i++) {
+      sum += (i >= 148 && i < 156) ? ' ' : header[i];
+    }
+    const auto checksum = number(header + 148, 8);
+    const auto size = number(header + 124, 12);
+    if (!checksum.has_value() || checksum.value() != sum || !size.has_value()) {
+      good_ = false;
+      return {};
+    }
+
+    const auto type = header[156];
+    if (type == 'L' || type == 'x' || type == 'g') {
+      const auto data = body(size.value());
+      if (!data.has_value()) {
+        good_ = false;
+        return {};
+      }
+      if (type == 'L') {
+        longName = data.value().substr(0, data.value().find('\0'));
+        continue;
+      }
+      if (type == 'g') {
+        continue;
+      }
+      /// pax records are "<length> <key>=<value>\n"
+      for (std::string_view records(data.value()); !records.empty();) {
+        const auto space = records.find(' ');
+        const auto length = std::strtoull(records.data(), nullptr, 10);
+        if (space == std::string_view::npos || length <= space
+            || length > records.size()) {
+          break;
+        }
+        const auto record = records.substr(space + 1, length - space - 2);
+        records.remove_prefix(length);
+        const auto equals = record.find('=');
+        const auto key = record.substr(0, equals);
+        const auto value = record.substr(equals + 1);
+        if (key == "path") {
+          longName = std::string(value);
+        } else if (key == "size") {
+          paxSize = std::strtoull(std::string(value).c_str(), nullptr, 10);
+        }
+      }
+      continue;
+    }
+
+    Entry entry;
+    entry.size = paxSize.value_or(size.value());
+    entry.regular = type == '0' || type == '\0' || type == '7';
+    if (longName.has_value()) {
+      entry.name = longName.value();
+    } else {
+      entry.name = text(header, 100);
+      const auto prefix = text(header + 345, 155);
+      if (text(header + 257, 5) == "ustar" && !prefix.empty()) {
+        entry.name = prefix + "/" + entry.name;
+      }
+    }
+    remaining_ = entry.size;
+    padding_ = (BLOCK - entry.size % BLOCK) % BLOCK;
+    return entry;
+  }
+}
+
+bool Reader::read(unsigned char* buffer, std::size_t length) {
+  if (!good_ || length > remaining_ || !readAll(buffer, length)) {
+    good_ = false;
+    return false;
+  }
+  remaining_ -= length;
+  return true;
+}
+
+bool Reader::good() const { return good_; }
+
+#ifdef __linux__
+bool Reader::readAll(void* buffer, std::size_t size) {
+  auto* at = static_cast<unsigned char*>(buffer);
+  while (size > 0) {
+    const auto got = ::read(fd_, at, size);
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      return false;
+    }
+    at += got;
+    size -= got;
+  }
+  return true;
+}
+#else
+#error your OS is not supported
+#endif
+
+bool Reader::skip(std::size_t size) {
+  unsigned char scratch[16 * BLOCK];
+  while (size > 0) {
+    const auto length = std::min(size, sizeof(scratch));
+    if (!readAll(scratch, length)) {
+      return false;
+    }
+    size -= length;
+  }
+  return true;
+}
+
+std::optional<std::string> Reader::body(std::size_t size) {
+  if (size > MAX_BODY) {
+    return {};
+  }
+  std::string ret(size, '\0');
+  if (
+      !readAll(ret.data(), size)
+      || !skip((BLOCK - size % BLOCK) % BLOCK)
+  ) {
+    return {};
+  }
+  return ret;
+}
+
+} /// namespace tar
+
+#endif /// TAR_TAR_HH_
@@ -1,29 +1,89 @@
 #include <args/args.hh>
-#include <cloud/cloud.hh>
+#include <cloudphoto/cloudphoto.hh>
 #include <input/input.hh>
 
+#include <algorithm>
+#include <filesystem>
 #include <map>
+#include <optional>
+#include <utility>
 
-int upload(args::Parser& parser, const cloud::Cloud& cl) {
+#include <fcntl.h>
+#include <unistd.h>
+
+int upload(args::Parser& parser, cloudphoto::Client& cl) {
   // const auto album = parser.find("--album");
   // const auto path = parser.find("--path"); /// !! to be checked
-  const auto validated =
-      parser.require("--album").optional("--path").validate();
+  const auto validated = parser.require("--album")
+      .optional("--path")
+      .optional("--from-tar")
+      .optional("--strip")
+      .optional("--shards")
+      .flag("--packed")
+      .flag("--watch")
+      .flag("--optimize")
+      .validate();
   if (!validated) {
     std::cerr << "Invalid usage or invalid parameters" << std::endl;
     return 1;
   }
   const auto album = parser.get("--album");
   const auto path = parser.get("--path"); /// !! to be checked
+  const auto tar = parser.get("--from-tar");
+  const auto strip = cloudphoto::parseStrip(parser.get("--strip"));
 
   if (album.empty()) {
     return 1;
   }
+  /// photos are re-encoded one object per photo, from files
+  if (
+      !strip.has_value()
+      || (!parser.get("--strip").empty() && !parser.has("--optimize"))
+      || (parser.has("--optimize")
+          && (parser.has("--packed") || !tar.empty()))
+  ) {
+    std::cerr << "Invalid usage or invalid parameters" << std::endl;
+    return 1;
+  }
+  if (parser.has("--optimize")) {
+    cl.setOptimize(true, strip.value());
+  }
+  /// only a new album is laid out, packs stay under the album's prefix
+  if (!parser.get("--shards").empty()) {
+    const auto shards = cloudphoto::parseSize(parser.get("--shards"));
+    if (
+      !shards.has_value()
+      || shards.value() > cloudphoto::MAX_SHARDS
+      || parser.has("--packed")
+    ) {
+      std::cerr << "Invalid usage or invalid parameters" << std::endl;
+      return 1;
+    }
+    cl.setShards(shards.value());
+  }
+  if (!tar.empty()) {
+    if (parser.has("--packed") || parser.has("--watch")) {
+      std::cerr << "Invalid usage or invalid parameters" << std::endl;
+      return 1;
+    }
+    /// '-' is the standard input
+    const int fd = tar == "-" ? 0 : ::open(tar.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return 1;
+    }
+    const auto uploaded = cl.uploadTar(album, fd);
+    if (fd != 0) {
+      ::close(fd);
+    }
+    return uploaded ? 0 : 1;
+  }
   if (
       !std::filesystem::is_directory(path)
       // || (std::filesystem::status(path).permissions()
           // != std::filesystem::perms::others_read)
-      || !cl.upload(album, path)
+      || !(parser.has("--watch")
+          ? cl.watch(album, path, parser.has("--packed"))
+          : cl.upload(album, path, parser.has("--packed")))
   ) {
     return 1;
   }
@@ -31,74 +91,122 @@ int upload(args::Parser& parser, const cloud::Cloud& cl) {
   return 0;
 }
 
-int download(args::Parser& parser, const cloud::Cloud& cl) {
+int download(args::Parser& parser, const cloudphoto::Client& cl) {
   // const auto album = parser.find("--album");
   // const auto path = parser.find("--path"); /// !! to be checked
-  const auto validated =
-      parser.require("--album").optional("--path").validate();
+  const auto validated = parser.require("--album")
+      .optional("--path")
+      .optional("--durability")
+      .validate();
   if (!validated) {
     std::cerr << "Invalid usage or invalid parameters" << std::endl;
     return 1;
   }
   const auto album = parser.get("--album");
   const auto path = parser.get("--path"); /// !! to be checked
+  const auto durability =
+      cloudphoto::parseDurability(parser.get("--durability"));
 
-  if (album.empty()) {
+  if (album.empty() || !durability.has_value()) {
     return 1;
   }
   if (
       !std::filesystem::is_directory(path)
       // || (std::filesystem::status(path).permissions()
           // != std::filesystem::perms::group_write)
-      || !cl.download(album, path)) {
+      || !cl.download(album, path, durability.value())) {
     return 1;
   }
 
   return 0;
 }
 
-int list(args::Parser& parser, const cloud::Cloud& cl) {
+int list(args::Parser& parser, const cloudphoto::Client& cl) {
   // const auto album = parser.find("--album");
-  const auto validated =
-      parser.optional("--album").validate();
+  const auto validated = parser.optional("--album")
+      .optional("--sort")
+      .flag("--long")
+      .validate();
   if (!validated) {
     std::cerr << "Invalid usage or invalid parameters" << std::endl;
     return 1;
   }
   const auto album = parser.get("--album");
+  const auto sort = parser.get("--sort");
+  if (!sort.empty() && sort != "name" && sort != "date") {
+    std::cerr << "Invalid usage or invalid parameters" << std::endl;
+    return 1;
+  }
 
   if (album.empty()) {
 
-    const auto albums = cl.albums();
+    std::size_t count = 0;
+    const auto listed = cl.albums([&count](std::string_view album) {
+      std::cout << album << std::endl;
+      count++;
+    });
 
-    if (!albums.has_value()) {
+    if (!listed) {
       return 1;
     }
 
-    if (albums.value().empty()) {
+    if (count == 0) {
       std::cout << "empty list" << std::endl;
-      return 0;
-    }
-
-    for (const auto& album : albums.value()) {
-      std::cout << album << std::endl;
     }
 
   } else {
 
-    const auto photos = cl.get(album);
-
-    if (!photos.has_value()) {
+    const auto print = [&parser](const cloudphoto::Photo& photo) {
+      std::cout << photo.name;
+      if (parser.has("--long")) {
+        const auto orDash = [](const std::string& value) {
+          return value.empty() ? std::string("-") : value;
+        };
+        std::cout << '\t' << orDash(photo.date)
+            << '\t' << (photo.width == 0 ? std::string("-")
+                : std::to_string(photo.width) + "x"
+                    + std::to_string(photo.height))
+            << '\t' << orDash(photo.camera);
+      }
+      std::cout << std::endl;
+    };
+
+    /// in name order photos are printed as they are listed
+    std::size_t count = 0;
+    std::vector<cloudphoto::Photo> photos;
+    const auto listed = cl.photos(
+        album,
+        [&](const cloudphoto::Photo& photo) {
+          count++;
+          if (sort == "date") {
+            photos.push_back(photo);
+          } else {
+            print(photo);
+          }
+        },
+        parser.has("--long") || sort == "date"
+    );
+
+    if (!listed) {
       return 1;
     }
 
-    if (photos.value().empty()) {
+    if (count == 0) {
       std::cout << "empty list" << std::endl;
       return 0;
     }
 
-    for (const auto& photo : photos.value()) {
-      std::cout << photo << std::endl;
+    std::stable_sort(
+        photos.begin(),
+        photos.end(),
+        [](const auto& lhs, const auto& rhs) {
+          return !lhs.date.empty() && (
+              rhs.date.empty() || lhs.date < rhs.date
+          );
+        }
+    );
+    for (const auto& photo : photos) {
+      print(photo);
     }
 
   }
@@ -106,7 +214,34 @@ int list(args::Parser& parser, const cloud::Cloud& cl) {
   return 0;
 }
 
-int del(args::Parser& parser, const cloud::Cloud& cl) {
+int backfill(args::Parser& parser, const cloudphoto::Client& cl) {
+  const auto validated = parser.optional("--album").validate();
+  if (!validated) {
+    std::cerr << "Invalid usage or invalid parameters" << std::endl;
+    return 1;
+  }
+  const auto album = parser.get("--album");
+
+  if (!album.empty()) {
+    return cl.backfill(album) ? 0 : 1;
+  }
+  std::vector<std::string> albums;
+  const auto listed = cl.albums([&albums](std::string_view album) {
+    albums.emplace_back(album);
+  });
+  if (!listed) {
+    return 1;
+  }
+  for (const auto& album : albums) {
+    if (!cl.backfill(album)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+int del(args::Parser& parser, const cloudphoto::Client& cl) {
   // const auto album = parser.find("--album");
   // const auto photo = parser.find("--photo"); /// !! to be checked
   const auto validated =
@@ -134,9 +269,127 @@ int del(args::Parser& parser, const cloud::Cloud& cl) {
   return 0;
 }
 
-int mksite(const cloud::Cloud& cl) {
-  const auto url = cl.mksite();
+int copy(args::Parser& parser, const cloudphoto::Client& cl, bool move) {
+  const auto validated =
+      parser.require("--album").require("--to").validate();
+  if (!validated) {
+    std::cerr << "Invalid usage or invalid parameters" << std::endl;
+    return 1;
+  }
+  const auto album = parser.get("--album");
+  const auto to = parser.get("--to");
+
+  if (move ? !cl.move(album, to) : !cl.copy(album, to)) {
+    return 1;
+  }
+
+  return 0;
+}
+
+int unpack(args::Parser& parser, const cloudphoto::Client& cl) {
+  const auto validated = parser.require("--album").validate();
+  if (!validated) {
+    std::cerr << "Invalid usage or invalid parameters" << std::endl;
+    return 1;
+  }
+
+  if (!cl.unpack(parser.get("--album"))) {
+    return 1;
+  }
+
+  return 0;
+}
+
+int verify(args::Parser& parser, const cloudphoto::Client& cl) {
+  const auto validated =
+      parser.require("--album").optional("--path").validate();
+  if (!validated) {
+    std::cerr << "Invalid usage or invalid parameters" << std::endl;
+    return 1;
+  }
+  const auto album = parser.get("--album");
+  const auto path = parser.get("--path"); /// !! to be checked
+
+  if (!std::filesystem::is_directory(path)) {
+    return 1;
+  }
+  const auto report = cl.verify(album, path);
+  if (!report.has_value()) {
+    return 1;
+  }
+
+  for (const auto& photo : report.value().missing) {
+    std::cout << "missing " << photo << std::endl;
+  }
+  for (const auto& photo : report.value().extra) {
+    std::cout << "extra " << photo << std::endl;
+  }
+  for (const auto& photo : report.value().mismatched) {
+    std::cout << "mismatched " << photo << std::endl;
+  }
+  for (const auto& photo : report.value().unverifiable) {
+    std::cout << "unverifiable " << photo << std::endl;
+  }
+
+  /// differences are reported, not an error
+  const auto differs = !report.value().missing.empty()
+      || !report.value().extra.empty()
+      || !report.value().mismatched.empty()
+      || !report.value().unverifiable.empty();
+  return differs ? 2 : 0;
+}
+
+int mirror(
+    args::Parser& parser,
+    const cloudphoto::Client& cl,
+    const std::optional<std::size_t>& maxMemory,
+    const std::optional<std::pair<std::size_t, std::size_t>>& limitRate
+) {
+  const auto validated =
+      parser.optional("--album").require("--to-config").validate();
+  if (!validated) {
+    std::cerr << "Invalid usage or invalid parameters" << std::endl;
+    return 1;
+  }
+  const auto album = parser.get("--album");
+  const auto config = parser.get("--to-config");
+
+  if (!std::filesystem::is_regular_file(config)) {
+    return 1;
+  }
+  cloudphoto::Client destination(config);
+  if (maxMemory.has_value()) {
+    destination.setMaxMemory(maxMemory.value());
+  }
+  /// the destination's PUTs are limited like the source's GETs
+  if (limitRate.has_value()) {
+    destination.setLimitRate(limitRate.value().first, limitRate.value().second);
+  }
+  if (!destination.init()) {
+    std::cerr << "Can not initialise destination" << std::endl;
+    return 1;
+  }
+  const auto mirrored = cl.mirror(album, destination);
+  if (!destination.deinit() || !mirrored) {
+    return 1;
+  }
+
+  return 0;
+}
+
+int mksite(args::Parser& parser, const cloudphoto::Client& cl) {
+  const auto validated = parser.flag("--vendor").validate();
+  if (!validated) {
+    std::cerr << "Invalid usage or invalid parameters" << std::endl;
+    return 1;
+  }
+  std::vector<std::string> packed;
+  const auto url = cl.mksite(parser.has("--vendor"), packed);
 
+  for (const auto& album : packed) {
+    std::cerr << "Album " << album << " is packed, run 'cloudphoto unpack"
+        << " --album " << album << "' to publish it" << std::endl;
+  }
   if (url.empty()) {
     return 1;
   }
@@ -145,7 +398,28 @@ int mksite(const cloud::Cloud& cl) {
   return 0;
 }
 
-int init(cloud::Cloud& cl) {
+int calibrate(args::Parser& parser, const cloudphoto::Client& cl) {
+  if (!parser.validate()) {
+    std::cerr << "Invalid usage or invalid parameters" << std::endl;
+    return 1;
+  }
+  const auto profile = cl.calibrate();
+
+  if (!profile.has_value()) {
+    return 1;
+  }
+
+  const auto& p = profile.value();
+  std::cout << "part_size = " << p.partSize << std::endl
+      << "concurrency = " << p.concurrency << std::endl
+      << "max_connections = " << p.maxConnections << std::endl
+      << "request_timeout_ms = " << p.requestTimeout.count() << std::endl
+      << "connect_timeout_ms = " << p.connectTimeout.count() << std::endl
+      << "tcp_keep_alive_ms = " << p.tcpKeepAlive.count() << std::endl;
+  return 0;
+}
+
+int init(cloudphoto::Client& cl) {
   const auto keyId = input::read("Enter key id: ");
   const auto key = input::read("Enter key: ");
   const auto bucket = input::read("Enter bucket name: ");
@@ -163,13 +437,20 @@ int init(cloud::Cloud& cl) {
 
 int main(int argc, char** argv) {
   args::Parser parser(argc, argv);
-  cloud::Cloud cl;
+  cloudphoto::Client cl;
   enum Command {
     UPLOAD,
     DOWNLOAD,
     LIST,
+    BACKFILL,
     DELETE,
+    COPY,
+    MOVE,
+    UNPACK,
+    VERIFY,
+    MIRROR,
     MKSITE,
+    CALIBRATE,
     INIT,
   };
 
@@ -177,8 +458,15 @@ int main(int argc, char** argv) {
     {"upload", Command::UPLOAD},
     {"download", Command::DOWNLOAD},
     {"list", Command::LIST},
+    {"backfill", Command::BACKFILL},
     {"delete", Command::DELETE},
+    {"copy", Command::COPY},
+    {"move", Command::MOVE},
+    {"unpack", Command::UNPACK},
+    {"verify", Command::VERIFY},
+    {"mirror", Command::MIRROR},
     {"mksite", Command::MKSITE},
+    {"calibrate", Command::CALIBRATE},
     {"init", Command::INIT},
   };
 
@@ -188,9 +476,36 @@ int main(int argc, char** argv) {
     return 1;
   }
   // std::cout << command.at(next) << std::endl;
+  parser.optional("--max-memory");
+  std::optional<std::size_t> maxMemory;
+  if (!parser.get("--max-memory").empty()) {
+    maxMemory = cloudphoto::parseSize(parser.get("--max-memory"));
+    if (!maxMemory.has_value()) {
+      std::cerr << "Invalid '--max-memory' value" << std::endl;
+      return 1;
+    }
+    cl.setMaxMemory(maxMemory.value());
+  }
+  /// '<rate>' limits both directions, '<up>/<down>' each of them
+  parser.optional("--limit-rate");
+  std::optional<std::pair<std::size_t, std::size_t>> limitRate;
+  if (!parser.get("--limit-rate").empty()) {
+    const auto value = parser.get("--limit-rate");
+    const auto slash = value.find('/');
+    const auto up = cloudphoto::parseSize(value.substr(0, slash));
+    const auto down = slash == std::string::npos
+        ? up
+        : cloudphoto::parseSize(value.substr(slash + 1));
+    if (!up.has_value() || !down.has_value()) {
+      std::cerr << "Invalid '--limit-rate' value" << std::endl;
+      return 1;
+    }
+    limitRate.emplace(up.value(), down.value());
+    cl.setLimitRate(up.value(), down.value());
+  }
   if (command.at(arg1) != Command::INIT) {
     if (!cl.init()) {
-      std::cerr << "Can not initialise 'cloud::Cloud' instance" << std::endl;
+      std::cerr << "Can not initialise 'cloudphoto::Client' instance" << std::endl;
       return 1;
     }
   }
@@ -220,18 +535,60 @@ int main(int argc, char** argv) {
       std::cerr << "Can not list" << std::endl;
     }
     break;
+  case Command::BACKFILL:
+    returnCode = backfill(parser, cl);
+    if (returnCode != 0) {
+      std::cerr << "Can not backfill" << std::endl;
+    }
+    break;
   case Command::DELETE:
     returnCode = del(parser, cl);
     if (returnCode != 0) {
       std::cerr << "Can not delete" << std::endl;
     }
     break;
+  case Command::COPY:
+    returnCode = copy(parser, cl, false);
+    if (returnCode != 0) {
+      std::cerr << "Can not copy" << std::endl;
+    }
+    break;
+  case Command::MOVE:
+    returnCode = copy(parser, cl, true);
+    if (returnCode != 0) {
+      std::cerr << "Can not move" << std::endl;
+    }
+    break;
+  case Command::UNPACK:
+    returnCode = unpack(parser, cl);
+    if (returnCode != 0) {
+      std::cerr << "Can not unpack" << std::endl;
+    }
+    break;
+  case Command::VERIFY:
+    returnCode = verify(parser, cl);
+    if (returnCode == 1) {
+      std::cerr << "Can not verify" << std::endl;
+    }
+    break;
+  case Command::MIRROR:
+    returnCode = mirror(parser, cl, maxMemory, limitRate);
+    if (returnCode != 0) {
+      std::cerr << "Can not mirror" << std::endl;
+    }
+    break;
   case Command::MKSITE:
-    returnCode = mksite(cl);
+    returnCode = mksite(parser, cl);
     if (returnCode != 0) {
       std::cerr << "Can not mksite" << std::endl;
     }
     break;
+  case Command::CALIBRATE:
+    returnCode = calibrate(parser, cl);
+    if (returnCode != 0) {
+      std::cerr << "Can not calibrate" << std::endl;
+    }
+    break;
   default:
     std::cerr << "Unknown command" << std::endl;
     return 1;
@@ -0,0 +1,339 @@
+#include <cloudphoto/cloudphoto.hh>
+/// the only translation unit of the library that includes the
+/// implementation headers, they define their functions out of line
+#include <cloud/cloud.hh>
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+namespace cloudphoto {
+
+static_assert(MAX_SHARDS == cloud::Cloud::MAX_SHARDS);
+
+class Client::Impl {
+public:
+  template <typename... Args>
+  explicit Impl(Args&&... args);
+  Impl(const Impl&) = delete;
+  Impl& operator=(const Impl&) = delete;
+
+  cloud::Cloud cloud;
+  Progress progress;
+  /// bodies sent or received for the album of each job 'run' is running,
+  /// told apart by key since the transfers of every call share the
+  /// callback
+  std::mutex mutex;
+  std::vector<std::pair<std::string, std::size_t>*> jobs;
+protected:
+private:
+};
+
+template <typename... Args>
+Client::Impl::Impl(Args&&... args) : cloud(std::forward<Args>(args)...) {
+  cloud.setProgress([this](const std::string& key, std::size_t size) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto* job : jobs) {
+        if (cloud::Cloud::isAlbumKey(job->first, key)) {
+          job->second += size;
+        }
+      }
+    }
+    if (progress) {
+      progress(key, size);
+    }
+  });
+}
+
+namespace {
+
+io::Durability convert(Durability durability) {
+  switch (durability) {
+  case Durability::FILE:
+    return io::Durability::FILE;
+  case Durability::BATCH:
+    return io::Durability::BATCH;
+  default:
+    return io::Durability::NONE;
+  }
+}
+
+} /// namespace
+
+Client::Client() : impl_(std::make_unique<Impl>()) {}
+
+Client::Client(const std::filesystem::path& configFile)
+    : impl_(std::make_unique<Impl>(configFile)) {}
+
+Client::Client(Client&& other) noexcept = default;
+
+Client& Client::operator=(Client&& other) noexcept {
+  if (this != &other) {
+    if (impl_) {
+      impl_->cloud.deinit();
+    }
+    impl_ = std::move(other.impl_);
+  }
+  return *this;
+}
+
+/// a client still initialised releases its share of the SDK, the last one
+/// shuts it down
+Client::~Client() {
+  if (impl_) {
+    impl_->cloud.deinit();
+  }
+}
+
+void Client::setMaxMemory(std::size_t bytes) {
+  impl_->cloud.setMaxMemory(bytes);
+}
+
+void Client::setLimitRate(std::size_t up, std::size_t down) {
+  impl_->cloud.setLimitRate(up, down);
+}
+
+void Client::setProgress(Progress progress) {
+  impl_->progress = std::move(progress);
+}
+
+void Client::setOptimize(bool optimize, Strip strip) {
+  if (!optimize) {
+    impl_->cloud.setOptimize(std::nullopt);
+    return;
+  }
+  impl_->cloud.setOptimize(
+      strip == Strip::THUMBNAIL ? jpeg::Strip::THUMBNAIL
+      : strip == Strip::ALL ? jpeg::Strip::ALL
+      : jpeg::Strip::NONE
+  );
+}
+
+void Client::setShards(std::size_t count) {
+  impl_->cloud.setShards(count);
+}
+
+bool Client::configure(
+    const std::string& keyId,
+    const std::string& key,
+    const std::string& bucket
+) {
+  return impl_->cloud.configure(keyId, key, bucket);
+}
+
+bool Client::init() { return impl_->cloud.init(); }
+
+bool Client::deinit() { return impl_->cloud.deinit(); }
+
+bool Client::upload(
+    const std::string& album,
+    const std::filesystem::path& dir,
+    bool packed
+) const {
+  return impl_->cloud.upload(album, dir, packed);
+}
+
+bool Client::watch(
+    const std::string& album,
+    const std::filesystem::path& dir,
+    bool packed
+) const {
+  return impl_->cloud.watch(album, dir, packed);
+}
+
+bool Client::uploadTar(const std::string& album, int fd) const {
+  return impl_->cloud.uploadTar(album, fd);
+}
+
+bool Client::download(
+    const std::string& album,
+    const std::filesystem::path& dir,
+    Durability durability
+) const {
+  return impl_->cloud.download(album, dir, convert(durability));
+}
+
+std::vector<Result> Client::run(const std::vector<Job>& jobs) const {
+  std::vector<Result> ret(jobs.size());
+  for (auto i = 0u; i < jobs.size(); i++) {
+    const auto& job = jobs[i];
+    const auto start = std::chrono::steady_clock::now();
+    std::pair<std::string, std::size_t> counted(job.album, 0);
+    {
+      std::lock_guard<std::mutex> lock(impl_->mutex);
+      impl_->jobs.push_back(&counted);
+    }
+    ret[i].ok = job.kind == Job::Kind::UPLOAD
+        ? upload(job.album, job.dir, job.packed)
+        : download(job.album, job.dir, job.durability);
+    {
+      std::lock_guard<std::mutex> lock(impl_->mutex);
+      impl_->jobs.erase(
+          std::find(impl_->jobs.begin(), impl_->jobs.end(), &counted)
+      );
+    }
+    ret[i].bytes = counted.second;
+    ret[i].elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start
+    );
+  }
+  return ret;
+}
+
+bool Client::albums(const std::function<void(std::string_view)>& each) const {
+  const auto albums = impl_->cloud.albums();
+  if (!albums.has_value()) {
+    return false;
+  }
+  for (const auto album : albums.value()) {
+    each(album);
+  }
+  return true;
+}
+
+bool Client::photos(
+    const std::string& album,
+    const std::function<void(const Photo&)>& each,
+    bool details
+) const {
+  const auto names = impl_->cloud.get(album);
+  if (!names.has_value()) {
+    return false;
+  }
+  std::optional<exif::Index> meta;
+  if (details) {
+    /// details come from the album's metadata index, not from the photos
+    meta = impl_->cloud.meta(album);
+    if (!meta.has_value()) {
+      return false;
+    }
+  }
+  Photo photo;
+  for (const auto name : names.value()) {
+    photo = Photo();
+    photo.name = name;
+    const auto* info = meta.has_value() ? meta.value().find(name) : nullptr;
+    if (info != nullptr) {
+      photo.date = exif::isoDate(info->date);
+      photo.camera = info->camera;
+      photo.width = info->width;
+      photo.height = info->height;
+    }
+    each(photo);
+  }
+  return true;
+}
+
+bool Client::backfill(const std::string& album) const {
+  return impl_->cloud.backfill(album);
+}
+
+bool Client::del(const std::string& album) const {
+  return impl_->cloud.del(album);
+}
+
+bool Client::del(const std::string& album, const std::string& photo) const {
+  return impl_->cloud.del(album, photo);
+}
+
+bool Client::copy(const std::string& album, const std::string& to) const {
+  return impl_->cloud.copy(album, to);
+}
+
+bool Client::move(const std::string& album, const std::string& to) const {
+  return impl_->cloud.move(album, to);
+}
+
+bool Client::unpack(const std::string& album) const {
+  return impl_->cloud.unpack(album);
+}
+
+std::optional<Report> Client::verify(
+    const std::string& album,
+    const std::filesystem::path& dir
+) const {
+  auto report = impl_->cloud.verify(album, dir);
+  if (!report.has_value()) {
+    return {};
+  }
+  Report ret;
+  ret.missing = std::move(report.value().missing);
+  ret.extra = std::move(report.value().extra);
+  ret.mismatched = std::move(report.value().mismatched);
+  ret.unverifiable = std::move(report.value().unverifiable);
+  return ret;
+}
+
+bool Client::mirror(
+    const std::string& album,
+    const Client& destination
+) const {
+  return impl_->cloud.mirror(album, destination.impl_->cloud);
+}
+
+std::string Client::mksite() const { return impl_->cloud.mksite(); }
+
+std::string Client::mksite(bool vendor) const {
+  return impl_->cloud.mksite(vendor);
+}
+
+std::string Client::mksite(
+    bool vendor,
+    std::vector<std::string>& packed
+) const {
+  return impl_->cloud.mksite(vendor, &packed);
+}
+
+std::optional<Profile> Client::calibrate() const {
+  const auto profile = impl_->cloud.calibrate();
+  if (!profile.has_value()) {
+    return {};
+  }
+  Profile ret;
+  ret.partSize = profile.value().partSize;
+  ret.concurrency = profile.value().concurrency;
+  ret.maxConnections = profile.value().maxConnections;
+  ret.requestTimeout =
+      std::chrono::milliseconds(profile.value().requestTimeoutMs);
+  ret.connectTimeout =
+      std::chrono::milliseconds(profile.value().connectTimeoutMs);
+  ret.tcpKeepAlive = std::chrono::milliseconds(profile.value().tcpKeepAliveMs);
+  return ret;
+}
+
+std::optional<std::size_t> parseSize(const std::string& value) {
+  return util::parseSize(value);
+}
+
+std::optional<Durability> parseDurability(const std::string& value) {
+  const auto durability = io::parseDurability(value);
+  if (!durability.has_value()) {
+    return {};
+  }
+  switch (durability.value()) {
+  case io::Durability::FILE:
+    return Durability::FILE;
+  case io::Durability::BATCH:
+    return Durability::BATCH;
+  default:
+    return Durability::NONE;
+  }
+}
+
+std::optional<Strip> parseStrip(const std::string& value) {
+  const auto strip = jpeg::parseStrip(value);
+  if (!strip.has_value()) {
+    return {};
+  }
+  switch (strip.value()) {
+  case jpeg::Strip::THUMBNAIL:
+    return Strip::THUMBNAIL;
+  case jpeg::Strip::ALL:
+    return Strip::ALL;
+  default:
+    return Strip::NONE;
+  }
+}
+
+} /// namespace cloudphoto
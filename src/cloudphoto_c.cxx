@@ -0,0 +1,298 @@
+#include <cloudphoto/cloudphoto.h>
+#include <cloudphoto/cloudphoto.hh>
+
+#include <memory>
+
+/// exceptions must not cross the C interface, every entry point turns them
+/// into a failure
+
+static_assert(CLOUDPHOTO_MAX_SHARDS == cloudphoto::MAX_SHARDS);
+
+struct cloudphoto_client {
+  cloudphoto::Client client;
+};
+
+namespace {
+
+cloudphoto::Durability toDurability(int value) {
+  switch (value) {
+  case CLOUDPHOTO_DURABILITY_FILE:
+    return cloudphoto::Durability::FILE;
+  case CLOUDPHOTO_DURABILITY_BATCH:
+    return cloudphoto::Durability::BATCH;
+  default:
+    return cloudphoto::Durability::NONE;
+  }
+}
+
+int status(bool ok) { return ok ? 0 : -1; }
+
+} /// namespace
+
+extern "C" {
+
+int cloudphoto_version(void) { return cloudphoto::VERSION_MAJOR; }
+
+cloudphoto_client* cloudphoto_open(const char* config, size_t max_memory) {
+  try {
+    /// the client releases its share of the SDK when it goes, however
+    /// 'init' failed
+    std::unique_ptr<cloudphoto_client> ret(config == nullptr
+        ? new cloudphoto_client{cloudphoto::Client()}
+        : new cloudphoto_client{cloudphoto::Client(config)});
+    if (max_memory > 0) {
+      ret->client.setMaxMemory(max_memory);
+    }
+    if (!ret->client.init()) {
+      return nullptr;
+    }
+    return ret.release();
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void cloudphoto_close(cloudphoto_client* client) {
+  /// the client is freed even if shutting the SDK down throws
+  std::unique_ptr<cloudphoto_client> owned(client);
+  if (owned == nullptr) {
+    return;
+  }
+  try {
+    owned->client.deinit();
+  } catch (...) {
+  }
+}
+
+int cloudphoto_set_limit_rate(
+    cloudphoto_client* client,
+    size_t up,
+    size_t down
+) {
+  try {
+    client->client.setLimitRate(up, down);
+    return 0;
+  } catch (...) {
+    return -1;
+  }
+}
+
+int cloudphoto_set_progress(
+    cloudphoto_client* client,
+    cloudphoto_progress progress,
+    void* user
+) {
+  try {
+    if (progress == nullptr) {
+      client->client.setProgress(nullptr);
+      return 0;
+    }
+    client->client.setProgress(
+        [progress, user](const std::string& key, std::size_t bytes) {
+          progress(key.c_str(), bytes, user);
+        }
+    );
+    return 0;
+  } catch (...) {
+    return -1;
+  }
+}
+
+int cloudphoto_set_optimize(
+    cloudphoto_client* client,
+    int optimize,
+    int strip
+) {
+  try {
+    client->client.setOptimize(
+        optimize != 0,
+        strip == CLOUDPHOTO_STRIP_THUMBNAIL ? cloudphoto::Strip::THUMBNAIL
+        : strip == CLOUDPHOTO_STRIP_ALL ? cloudphoto::Strip::ALL
+        : cloudphoto::Strip::NONE
+    );
+    return 0;
+  } catch (...) {
+    return -1;
+  }
+}
+
+int cloudphoto_set_shards(cloudphoto_client* client, size_t count) {
+  try {
+    client->client.setShards(count);
+    return 0;
+  } catch (...) {
+    return -1;
+  }
+}
+
+int cloudphoto_upload(
+    cloudphoto_client* client,
+    const char* album,
+    const char* dir,
+    int packed
+) {
+  try {
+    return status(client->client.upload(album, dir, packed != 0));
+  } catch (...) {
+    return -1;
+  }
+}
+
+int cloudphoto_download(
+    cloudphoto_client* client,
+    const char* album,
+    const char* dir,
+    int durability
+) {
+  try {
+    return status(
+        client->client.download(album, dir, toDurability(durability))
+    );
+  } catch (...) {
+    return -1;
+  }
+}
+
+int cloudphoto_run(
+    cloudphoto_client* client,
+    const cloudphoto_job* jobs,
+    size_t count,
+    cloudphoto_result* results
+) {
+  try {
+    std::vector<cloudphoto::Job> batch(count);
+    for (auto i = 0u; i < count; i++) {
+      batch[i].kind = jobs[i].kind == CLOUDPHOTO_DOWNLOAD
+          ? cloudphoto::Job::Kind::DOWNLOAD
+          : cloudphoto::Job::Kind::UPLOAD;
+      batch[i].album = jobs[i].album;
+      batch[i].dir = jobs[i].dir;
+      batch[i].packed = jobs[i].packed != 0;
+      batch[i].durability = toDurability(jobs[i].durability);
+    }
+    const auto done = client->client.run(batch);
+    int failed = 0;
+    for (auto i = 0u; i < count; i++) {
+      results[i].ok = done[i].ok ? 1 : 0;
+      results[i].bytes = done[i].bytes;
+      results[i].elapsed_ms = done[i].elapsed.count();
+      failed += done[i].ok ? 0 : 1;
+    }
+    return failed;
+  } catch (...) {
+    return -1;
+  }
+}
+
+int cloudphoto_albums(
+    cloudphoto_client* client,
+    cloudphoto_name each,
+    void* user
+) {
+  try {
+    std::string name;
+    return status(client->client.albums([&](std::string_view album) {
+      name = album;
+      each(name.c_str(), user);
+    }));
+  } catch (...) {
+    return -1;
+  }
+}
+
+int cloudphoto_photos(
+    cloudphoto_client* client,
+    const char* album,
+    cloudphoto_name each,
+    void* user
+) {
+  try {
+    return status(client->client.photos(
+        album,
+        [&](const cloudphoto::Photo& photo) { each(photo.name.c_str(), user); }
+    ));
+  } catch (...) {
+    return -1;
+  }
+}
+
+int cloudphoto_delete(
+    cloudphoto_client* client,
+    const char* album,
+    const char* photo
+) {
+  try {
+    return status(photo == nullptr
+        ? client->client.del(album)
+        : client->client.del(album, photo));
+  } catch (...) {
+    return -1;
+  }
+}
+
+int cloudphoto_copy(
+    cloudphoto_client* client,
+    const char* album,
+    const char* to
+) {
+  try {
+    return status(client->client.copy(album, to));
+  } catch (...) {
+    return -1;
+  }
+}
+
+int cloudphoto_move(
+    cloudphoto_client* client,
+    const char* album,
+    const char* to
+) {
+  try {
+    return status(client->client.move(album, to));
+  } catch (...) {
+    return -1;
+  }
+}
+
+int cloudphoto_verify(
+    cloudphoto_client* client,
+    const char* album,
+    const char* dir,
+    cloudphoto_difference each,
+    void* user
+) {
+  try {
+    const auto report = client->client.verify(album, dir);
+    if (!report.has_value()) {
+      return -1;
+    }
+    const std::pair<int, const std::vector<std::string>*> kinds[] = {
+      {CLOUDPHOTO_MISSING, &report.value().missing},
+      {CLOUDPHOTO_EXTRA, &report.value().extra},
+      {CLOUDPHOTO_MISMATCHED, &report.value().mismatched},
+      {CLOUDPHOTO_UNVERIFIABLE, &report.value().unverifiable},
+    };
+    int ret = 0;
+    for (const auto& [kind, names] : kinds) {
+      for (const auto& name : *names) {
+        if (each != nullptr) {
+          each(kind, name.c_str(), user);
+        }
+        ret = 1;
+      }
+    }
+    return ret;
+  } catch (...) {
+    return -1;
+  }
+}
+
+int cloudphoto_calibrate(cloudphoto_client* client) {
+  try {
+    return status(client->client.calibrate().has_value());
+  } catch (...) {
+    return -1;
+  }
+}
+
+} /// extern "C"
@@ -0,0 +1,190 @@
+/// standalone check of the parallel listing: 'Cloud::objects' lists a
+/// bucket held in memory, the ranges it cuts must be disjoint and cover the
+/// prefix and the pieces merge into key order; 'drain' stops after a failed
+/// task
+#include <cloud/cloud.hh>
+#include <parallel/parallel.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+//! keys a listing returns at most at once
+constexpr std::size_t PAGE_SIZE = 1000;
+
+//! bucket of 'keys' without objects behind them, listed page by page as
+//! the storage does
+class Listing : public cloud::Cloud {
+public:
+  Listing(std::vector<std::string> keys, std::size_t workers)
+      : Cloud(std::filesystem::path()), keys_(std::move(keys)) {
+    /// the workers of a listing are the slabs of the pool
+    pool_ = std::make_unique<pool::Pool>(workers, 4096);
+  }
+  using Cloud::objects;
+  //! requests that started after a bound rather than after a listed key
+  std::size_t splits() const { return splits_; }
+protected:
+  Aws::S3::Model::ListObjectsV2Outcome listObjects(
+      const Aws::S3::Model::ListObjectsV2Request& request
+  ) const override {
+    const std::string prefix(request.GetPrefix());
+    const std::string after(request.GetStartAfter());
+    auto it = std::upper_bound(
+        keys_.begin(), keys_.end(), std::max(after, prefix)
+    );
+    if (after.empty()) {
+      it = std::lower_bound(keys_.begin(), keys_.end(), prefix);
+    } else if (!std::binary_search(keys_.begin(), keys_.end(), after)) {
+      splits_++;
+    }
+    Aws::Vector<Aws::S3::Model::Object> contents;
+    for (; it != keys_.end() && contents.size() < PAGE_SIZE; it++) {
+      if (it->compare(0, prefix.size(), prefix) != 0) {
+        break;
+      }
+      Aws::S3::Model::Object object;
+      object.SetKey(*it);
+      contents.push_back(object);
+    }
+    Aws::S3::Model::ListObjectsV2Result result;
+    result.SetContents(contents);
+    result.SetIsTruncated(
+        it != keys_.end() && it->compare(0, prefix.size(), prefix) == 0
+    );
+    return Aws::S3::Model::ListObjectsV2Outcome(result);
+  }
+
+  std::vector<std::string> keys_;
+  mutable std::atomic<std::size_t> splits_ = 0;
+private:
+};
+
+bool check(bool ok, const std::string& what) {
+  if (!ok) {
+    std::cerr << "FAILED: " << what << std::endl;
+  }
+  return ok;
+}
+
+//! names the way cameras and people give them, with a few outside ASCII,
+//! next to another album
+std::vector<std::string> keys(std::size_t count, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::vector<std::string> ret;
+  for (auto i = 0u; i < count; i++) {
+    switch (rng() % 4) {
+      case 0:
+        ret.push_back("album/IMG_" + std::to_string(rng() % 100000));
+        break;
+      case 1:
+        ret.push_back(
+            "album/" + std::string(1, static_cast<char>('a' + rng() % 26))
+            + std::to_string(rng())
+        );
+        break;
+      case 2:
+        ret.push_back(
+            "album/" + std::string(1, static_cast<char>('A' + rng() % 26))
+            + std::to_string(rng() % 1000)
+        );
+        break;
+      default:
+        ret.push_back("album/\xc3\xa9t\xc3\xa9" + std::to_string(rng() % 1000));
+        break;
+    }
+  }
+  ret.push_back("album/~last");
+  ret.push_back("albun/other");
+  ret.push_back("alb/other");
+  std::sort(ret.begin(), ret.end());
+  ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+  return ret;
+}
+
+bool checkListing() {
+  auto ok = true;
+  for (const auto count : {0u, 1u, 999u, 1000u, 1001u, 50000u}) {
+    for (const auto workers : {1u, 4u, 32u}) {
+      const auto stored = keys(count, count + workers);
+      std::vector<std::string> expected;
+      for (const auto& key : stored) {
+        if (key.compare(0, 6, "album/") == 0) {
+          expected.push_back(key);
+        }
+      }
+      const Listing bucket(stored, workers);
+      const auto objects = bucket.objects(std::string("album/"));
+      const auto name = std::to_string(expected.size()) + " keys on "
+          + std::to_string(workers) + " workers";
+      if (!check(objects.has_value(), "listing succeeds, " + name)) {
+        ok = false;
+        continue;
+      }
+      std::vector<std::string> listed;
+      for (const auto& object : objects.value()) {
+        listed.push_back(object.key);
+      }
+      ok = check(
+          std::is_sorted(listed.begin(), listed.end()),
+          "merged listing in key order, " + name
+      ) && ok;
+      ok = check(
+          listed == expected,
+          "ranges disjoint and covering the prefix, " + name
+      ) && ok;
+      if (expected.size() > 10 * PAGE_SIZE && workers > 1) {
+        ok = check(bucket.splits() > 0, "idle workers split, " + name) && ok;
+      }
+    }
+  }
+  return ok;
+}
+
+bool checkDrain() {
+  /// every item adds two more without end, only a failure stops it
+  std::atomic<std::size_t> done = 0;
+  const auto failed = !parallel::drain(
+      std::vector<std::size_t>{0},
+      8,
+      [&done](std::size_t depth, parallel::Queue<std::size_t>& queue) {
+        done++;
+        queue.push(depth + 1);
+        queue.push(depth + 1);
+        return depth < 6;
+      }
+  );
+  auto ok = check(failed, "drain reports a failed task");
+  ok = check(done < 1000000, "drain stops handing out items") && ok;
+
+  /// a finite tree is worked off completely
+  done = 0;
+  const auto drained = parallel::drain(
+      std::vector<std::size_t>{0, 0},
+      8,
+      [&done](std::size_t depth, parallel::Queue<std::size_t>& queue) {
+        done++;
+        if (depth < 9) {
+          queue.push(depth + 1);
+          queue.push(depth + 1);
+        }
+        return true;
+      }
+  );
+  ok = check(drained && done == 2 * 1023, "drain works off every item") && ok;
+  return ok;
+}
+
+} /// namespace
+
+int main() {
+  const auto listing = checkListing();
+  const auto drain = checkDrain();
+  return listing && drain ? 0 : 1;
+}